@@ -0,0 +1,139 @@
+#include "blocked_jacobi.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Ghost cells either side of one row, as Field2D::fillBoundary would set them
+template <typename Real>
+void fillColumnHalo(Real* row, int cols, BoundaryCondition condition) {
+    switch (condition) {
+        case BoundaryCondition::Zero:
+            row[-1] = 0;
+            row[cols] = 0;
+            break;
+        case BoundaryCondition::Periodic:
+            row[-1] = row[cols - 1];
+            row[cols] = row[0];
+            break;
+        case BoundaryCondition::Antisymmetric:
+            row[-1] = -row[0];
+            row[cols] = -row[cols - 1];
+            break;
+        case BoundaryCondition::Clamp:
+        default:
+            row[-1] = row[0];
+            row[cols] = row[cols - 1];
+            break;
+    }
+}
+
+// Ghost row above or below the edge row, halo columns included
+template <typename Real>
+void fillGhostRow(Real* ghost, const Real* edge, int cols, BoundaryCondition condition) {
+    for (int j = -1; j <= cols; j++) {
+        switch (condition) {
+            case BoundaryCondition::Zero: ghost[j] = 0; break;
+            case BoundaryCondition::Antisymmetric: ghost[j] = -edge[j]; break;
+            default: ghost[j] = edge[j]; break;
+        }
+    }
+}
+
+}
+
+template <typename Real>
+void BlockedJacobi<Real>::resize(int rows, int cols, int bands) {
+    int scratchRows = std::min(tileRows, rows) + 2 * depth;
+    scratch.resize(std::max(1, bands));
+    for (Scratch& s : scratch) {
+        s.levels[0].resize(scratchRows, cols, Real(0), 1);
+        s.levels[1].resize(scratchRows, cols, Real(0), 1);
+    }
+}
+
+template <typename Real>
+std::size_t BlockedJacobi<Real>::scratchBytes() const {
+    if (scratch.empty()) return 0;
+    const Field2D<Real>& level = scratch[0].levels[0];
+    return 2 * static_cast<std::size_t>(level.rows() + 2) * level.stride() * sizeof(Real);
+}
+
+template <typename Real>
+void BlockedJacobi<Real>::run(BasicVelocityField<Real>& out, const BasicVelocityField<Real>& before,
+                              const BasicVelocityField<Real>& start, int iterations, Real alpha, Real denominator,
+                              Field2D<double>* rowResiduals) {
+    int rows = out.rows();
+    int tiles = (rows + tileRows - 1) / tileRows;
+    int bands = static_cast<int>(scratch.size());
+
+    // one item per band, so each band owns scratch[band] and a contiguous run of tiles
+    parallelRows(pool, bands, [&](int bandBegin, int bandEnd) {
+        for (int band = bandBegin; band < bandEnd; band++) {
+            int tileBegin = static_cast<int>(static_cast<long long>(tiles) * band / bands);
+            int tileEnd = static_cast<int>(static_cast<long long>(tiles) * (band + 1) / bands);
+            for (int tile = tileBegin; tile < tileEnd; tile++) {
+                int rowBegin = tile * tileRows;
+                int rowEnd = std::min(rows, rowBegin + tileRows);
+                runTile(scratch[band], out.u, before.u, start.u, rowBegin, rowEnd, iterations,
+                        alpha, denominator, rowResiduals, true);
+                runTile(scratch[band], out.v, before.v, start.v, rowBegin, rowEnd, iterations,
+                        alpha, denominator, rowResiduals, false);
+            }
+        }
+    });
+}
+
+template <typename Real>
+void BlockedJacobi<Real>::runTile(Scratch& s, Field2D<Real>& out, const Field2D<Real>& before,
+                                  const Field2D<Real>& start, int rowBegin, int rowEnd, int iterations,
+                                  Real alpha, Real denominator, Field2D<double>* rowResiduals, bool firstPlane) {
+    int rows = out.rows();
+    int cols = out.cols();
+    bool periodic = boundaryCondition == BoundaryCondition::Periodic;
+    auto wrap = [&](int i) { return periodic ? ((i % rows) + rows) % rows : i; };
+
+    // scratch row 0 holds grid row rowBegin - iterations. Periodic trapezoids run past the
+    // edges and read the wrapped rows; the others stop at the edge and get ghost rows instead.
+    int base = rowBegin - iterations;
+
+    for (int k = 1; k <= iterations; k++) {
+        int lo = rowBegin - (iterations - k);
+        int hi = rowEnd + (iterations - k);
+        if (!periodic) {
+            lo = std::max(lo, 0);
+            hi = std::min(hi, rows);
+        }
+        const Field2D<Real>& previous = s.levels[(k - 1) % 2];
+        Field2D<Real>& current = s.levels[k % 2];
+        auto source = [&](int i) -> const Real* {
+            return k == 1 ? start.row(wrap(i)) : previous.row(i - base);
+        };
+        bool last = k == iterations;
+
+        for (int i = lo; i < hi; i++) {
+            Real* o = last ? out.row(i) : current.row(i - base);
+            const Real* mid = source(i);
+            kernels->jacobiRow(o, before.row(wrap(i)), source(i - 1), mid, source(i + 1), cols, alpha, denominator);
+            if (!last) {
+                fillColumnHalo(o, cols, boundaryCondition);
+            }
+            else if (rowResiduals) {
+                Real change = 0;
+                for (int j = 0; j < cols; j++) {
+                    change = std::max(change, std::abs(o[j] - mid[j]));
+                }
+                double residual = double(denominator) * change;
+                (*rowResiduals)(i, 0) = firstPlane ? residual : std::max((*rowResiduals)(i, 0), residual);
+            }
+        }
+
+        if (!last && !periodic) {
+            if (lo == 0) fillGhostRow(current.row(-1 - base), current.row(-base), cols, boundaryCondition);
+            if (hi == rows) fillGhostRow(current.row(rows - base), current.row(rows - 1 - base), cols, boundaryCondition);
+        }
+    }
+}
+
+template class BlockedJacobi<float>;
+template class BlockedJacobi<double>;
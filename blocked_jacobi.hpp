@@ -0,0 +1,52 @@
+#ifndef BLOCKED_JACOBI_HPP
+#define BLOCKED_JACOBI_HPP
+
+#include "field2d.hpp"
+#include "stencil_kernels.hpp"
+#include "thread_pool.hpp"
+#include <vector>
+
+// Temporally blocked Jacobi sweeps for the diffusion step. Instead of streaming the whole
+// field once per iteration, the rows are cut into tiles of tileRows and each tile runs
+// several iterations back to back in a small scratch buffer that stays in cache. Iteration k
+// of a depth-d block computes the tile plus d - k overlapping rows on either side (a
+// trapezoid), so no tile waits on its neighbours; the overlap is recomputed, not exchanged.
+// Every cell goes through the same jacobiRow kernel with the same inputs as in a plain sweep,
+// so the result is bit-identical. Scratch is allocated by resize(), one pair per pool band.
+template <typename Real>
+class BlockedJacobi {
+public:
+    int tileRows = 32;
+    int depth = 4;    // iterations per block; resize() sizes the scratch for this
+
+    BoundaryCondition boundaryCondition = BoundaryCondition::Clamp;
+    const StencilKernels<Real>* kernels = &scalarStencilKernels<Real>();
+    ThreadPool* pool = nullptr;
+
+    // Allocates scratch for rows x cols fields and bands concurrent workers
+    void resize(int rows, int cols, int bands);
+
+    // Runs iterations (at most depth) Jacobi sweeps
+    //   x' = (before + alpha * (sum of x's four neighbours)) / denominator
+    // starting from x = start, whose halo must be filled, and writes the last iterate to out.
+    // With rowResiduals, row i receives denominator * max |last - previous iterate| over u and v.
+    void run(BasicVelocityField<Real>& out, const BasicVelocityField<Real>& before,
+             const BasicVelocityField<Real>& start, int iterations, Real alpha, Real denominator,
+             Field2D<double>* rowResiduals);
+
+    // Bytes of scratch one band keeps hot while it works on a tile
+    std::size_t scratchBytes() const;
+
+private:
+    struct Scratch {
+        Field2D<Real> levels[2];    // ping-pong iterates of one plane, tileRows + 2 * depth rows
+    };
+    std::vector<Scratch> scratch;
+
+    // Runs one plane of one tile, output rows [rowBegin, rowEnd)
+    void runTile(Scratch& s, Field2D<Real>& out, const Field2D<Real>& before, const Field2D<Real>& start,
+                 int rowBegin, int rowEnd, int iterations, Real alpha, Real denominator,
+                 Field2D<double>* rowResiduals, bool firstPlane);
+};
+
+#endif // BLOCKED_JACOBI_HPP
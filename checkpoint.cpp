@@ -0,0 +1,262 @@
+#include "checkpoint.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// magic, version, value size, width, height, config bytes, step, time
+constexpr std::size_t CHECKPOINT_HEADER_BYTES = 24 + 8 + sizeof(double);
+
+template <typename T>
+void append(std::vector<unsigned char>& out, const T& value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T readAt(const unsigned char* data, std::size_t offset) {
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+std::uint64_t checksum(const unsigned char* data, std::size_t bytes) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < bytes; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+template <typename Real>
+void appendField(std::vector<unsigned char>& out, const Field2D<Real>& field) {
+    for (int i = 0; i < field.rows(); i++) {
+        const unsigned char* row = reinterpret_cast<const unsigned char*>(field.row(i));
+        out.insert(out.end(), row, row + field.cols() * sizeof(Real));
+    }
+}
+
+template <typename Real>
+void readField(const unsigned char* data, std::size_t& offset, Field2D<Real>& field) {
+    for (int i = 0; i < field.rows(); i++) {
+        std::memcpy(field.row(i), data + offset, field.cols() * sizeof(Real));
+        offset += field.cols() * sizeof(Real);
+    }
+}
+
+bool writeFile(const std::string& path, const std::vector<unsigned char>& data) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0) return false;
+
+    bool ok = true;
+    std::size_t done = 0;
+    while (ok && done < data.size()) {
+#ifdef _WIN32
+        long wrote = _write(fd, data.data() + done, static_cast<unsigned int>(std::min<std::size_t>(data.size() - done, 1u << 30)));
+#else
+        long wrote = static_cast<long>(::write(fd, data.data() + done, data.size() - done));
+#endif
+        ok = wrote > 0;
+        if (ok) done += static_cast<std::size_t>(wrote);
+    }
+#ifdef _WIN32
+    ok = ok && _commit(fd) == 0;
+    return (_close(fd) == 0) && ok;
+#else
+    ok = ok && fsync(fd) == 0;
+    return (::close(fd) == 0) && ok;
+#endif
+}
+
+// Reads a whole checkpoint and checks everything but the fields' sizes against the header
+bool loadCheckpoint(const std::string& path, std::vector<unsigned char>& data, SimulationConfig& config) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Failed to open checkpoint: " << path << std::endl;
+        return false;
+    }
+    data.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size())) {
+        std::cerr << "Failed to read checkpoint: " << path << std::endl;
+        return false;
+    }
+
+    if (data.size() < CHECKPOINT_HEADER_BYTES + sizeof(std::uint64_t) ||
+        std::memcmp(data.data(), CHECKPOINT_MAGIC, 4) != 0) {
+        std::cerr << path << " is not a checkpoint" << std::endl;
+        return false;
+    }
+    std::uint32_t version = readAt<std::uint32_t>(data.data(), 4);
+    if (version != CHECKPOINT_VERSION) {
+        std::cerr << path << ": unsupported checkpoint version " << version << std::endl;
+        return false;
+    }
+    std::size_t body = data.size() - sizeof(std::uint64_t);
+    if (readAt<std::uint64_t>(data.data(), body) != checksum(data.data(), body)) {
+        std::cerr << path << ": checkpoint is corrupted (checksum mismatch)" << std::endl;
+        return false;
+    }
+
+    std::uint32_t configBytes = readAt<std::uint32_t>(data.data(), 20);
+    if (CHECKPOINT_HEADER_BYTES + configBytes > body) {
+        std::cerr << path << ": checkpoint is truncated" << std::endl;
+        return false;
+    }
+    std::istringstream text(std::string(reinterpret_cast<const char*>(data.data()) + CHECKPOINT_HEADER_BYTES, configBytes));
+    config = SimulationConfig();
+    if (!config.parse(text, path) || !config.validate()) {
+        return false;
+    }
+    if (config.width != readAt<std::int32_t>(data.data(), 12) || config.height != readAt<std::int32_t>(data.data(), 16)) {
+        std::cerr << path << ": checkpoint size does not match its config" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+template <typename Real>
+void SolverState<Real>::resize() {
+    if (velocity.rows() != config.height || velocity.cols() != config.width) {
+        velocity.resize(config.height, config.width);
+        pressure.resize(config.height, config.width);
+    }
+}
+
+template <typename Real>
+bool writeCheckpoint(const std::string& path, const SolverState<Real>& state, std::vector<unsigned char>& buffer) {
+    std::ostringstream text;
+    state.config.save(text);
+    std::string config = text.str();
+
+    buffer.clear();
+    buffer.insert(buffer.end(), CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 4);
+    append(buffer, CHECKPOINT_VERSION);
+    append(buffer, static_cast<std::uint32_t>(sizeof(Real)));
+    append(buffer, static_cast<std::int32_t>(state.velocity.cols()));
+    append(buffer, static_cast<std::int32_t>(state.velocity.rows()));
+    append(buffer, static_cast<std::uint32_t>(config.size()));
+    append(buffer, static_cast<std::int64_t>(state.step));
+    append(buffer, state.time);
+    buffer.insert(buffer.end(), config.begin(), config.end());
+    buffer.resize((buffer.size() + 7) / 8 * 8, 0);
+    appendField(buffer, state.velocity.u);
+    appendField(buffer, state.velocity.v);
+    appendField(buffer, state.pressure);
+    append(buffer, checksum(buffer.data(), buffer.size()));
+
+    std::string temporary = path + ".tmp";
+    if (!writeFile(temporary, buffer)) {
+        std::cerr << "Failed to write checkpoint: " << temporary << std::endl;
+        return false;
+    }
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to rename " << temporary << " to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+template <typename Real>
+bool readCheckpoint(const std::string& path, SolverState<Real>& state) {
+    std::vector<unsigned char> data;
+    if (!loadCheckpoint(path, data, state.config)) {
+        return false;
+    }
+    std::uint32_t bytesPerValue = readAt<std::uint32_t>(data.data(), 8);
+    if (bytesPerValue != sizeof(Real)) {
+        std::cerr << path << " holds " << (bytesPerValue == 4 ? "float" : "double") << " state, expected "
+                  << precisionName(precisionOf<Real>()) << std::endl;
+        return false;
+    }
+    std::uint32_t configBytes = readAt<std::uint32_t>(data.data(), 20);
+    std::size_t offset = (CHECKPOINT_HEADER_BYTES + configBytes + 7) / 8 * 8;
+    std::size_t cells = static_cast<std::size_t>(state.config.width) * state.config.height;
+    if (offset + 3 * cells * sizeof(Real) + sizeof(std::uint64_t) != data.size()) {
+        std::cerr << path << ": checkpoint is truncated" << std::endl;
+        return false;
+    }
+
+    state.step = static_cast<long>(readAt<std::int64_t>(data.data(), 24));
+    state.time = readAt<double>(data.data(), 32);
+    state.resize();
+    readField(data.data(), offset, state.velocity.u);
+    readField(data.data(), offset, state.velocity.v);
+    readField(data.data(), offset, state.pressure);
+    return true;
+}
+
+bool readCheckpointConfig(const std::string& path, SimulationConfig& config) {
+    std::vector<unsigned char> data;
+    return loadCheckpoint(path, data, config);
+}
+
+template <typename Real>
+SolverState<Real>& CheckpointWriter<Real>::snapshot() {
+    join();
+    return state;
+}
+
+template <typename Real>
+void CheckpointWriter<Real>::write(const std::string& path) {
+    join();
+    writing.store(true, std::memory_order_release);
+    thread = std::thread([this, path] {
+        auto start = std::chrono::steady_clock::now();
+        threadOk = writeCheckpoint(path, state, buffer);
+        threadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        writing.store(false, std::memory_order_release);
+    });
+}
+
+template <typename Real>
+void CheckpointWriter<Real>::join() {
+    if (!thread.joinable()) return;
+    thread.join();
+    if (threadOk) {
+        written++;
+        writeSeconds = threadSeconds;
+    }
+    else {
+        failed = true;
+    }
+}
+
+template <typename Real>
+bool CheckpointWriter<Real>::finish() {
+    join();
+    return !failed;
+}
+
+template struct SolverState<float>;
+template struct SolverState<double>;
+template bool writeCheckpoint(const std::string&, const SolverState<float>&, std::vector<unsigned char>&);
+template bool writeCheckpoint(const std::string&, const SolverState<double>&, std::vector<unsigned char>&);
+template bool readCheckpoint(const std::string&, SolverState<float>&);
+template bool readCheckpoint(const std::string&, SolverState<double>&);
+template class CheckpointWriter<float>;
+template class CheckpointWriter<double>;
@@ -0,0 +1,90 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "field2d.hpp"
+#include "simulation_config.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Everything a solver needs to continue a run exactly where it stopped: the config it runs
+// with, how far it got, the velocity and the pressure it warm-starts the next projection from.
+// Fields are halo-free; the halos are refilled from the interior before every use.
+template <typename Real>
+struct SolverState {
+    SimulationConfig config;
+    long step = 0;
+    double time = 0;
+    BasicVelocityField<Real> velocity;
+    Field2D<Real> pressure;
+
+    // Sizes the fields for config's grid
+    void resize();
+};
+
+// Checkpoint file, little-endian:
+//   char[4] "NSCK", uint32 version, uint32 bytes per value, int32 width, int32 height,
+//   uint32 config text bytes, int64 step, double time,
+//   config text (SimulationConfig::save), zero-padded to a multiple of 8 bytes,
+//   u, v and pressure, each height rows of width values in the grid's precision,
+//   uint64 FNV-1a checksum of everything before it
+// The values are stored as they are, so a restart continues bit for bit.
+constexpr char CHECKPOINT_MAGIC[4] = { 'N', 'S', 'C', 'K' };
+constexpr std::uint32_t CHECKPOINT_VERSION = 1;
+
+// Writes state to path.tmp, syncs it and renames it over path, so a crash while writing
+// leaves the previous checkpoint in place. Uses and grows buffer for the file image.
+template <typename Real>
+bool writeCheckpoint(const std::string& path, const SolverState<Real>& state, std::vector<unsigned char>& buffer);
+
+// Reads a checkpoint written in this precision; prints the problem and returns false if the
+// file is missing, truncated, corrupted or in the other precision
+template <typename Real>
+bool readCheckpoint(const std::string& path, SolverState<Real>& state);
+
+// Reads only the config of a checkpoint, to learn its precision and size before loading it
+bool readCheckpointConfig(const std::string& path, SimulationConfig& config);
+
+// Writes checkpoints on a background thread, so the step loop only pays for copying its state
+// into snapshot(). One checkpoint is written at a time; while it is, busy() is true and a
+// caller that does not want to wait simply tries again on a later step.
+template <typename Real>
+class CheckpointWriter {
+public:
+    CheckpointWriter() = default;
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+    ~CheckpointWriter() { finish(); }
+
+    bool busy() const { return writing.load(std::memory_order_acquire); }
+
+    // The state the next write() saves; waits for a write in progress first
+    SolverState<Real>& snapshot();
+
+    // Starts writing snapshot() to path
+    void write(const std::string& path);
+
+    // Waits for a write in progress; false if any checkpoint failed to write
+    bool finish();
+
+    int checkpointsWritten() const { return written; }
+    double lastWriteSeconds() const { return writeSeconds; }
+
+private:
+    // Joins the writing thread and collects its result
+    void join();
+
+    SolverState<Real> state;
+    std::vector<unsigned char> buffer;
+    std::thread thread;
+    std::atomic<bool> writing{ false };
+    bool threadOk = true;           // set by the thread, read after join()
+    double threadSeconds = 0;
+    bool failed = false;
+    int written = 0;
+    double writeSeconds = 0;
+};
+
+#endif // CHECKPOINT_HPP
@@ -1,31 +1,39 @@
 #include "coords.hpp"
 #include <cmath>
 
-Vec Vec::add(Vec a, Vec b) {
-    Vec res;
+template <typename Real>
+BasicVec<Real> BasicVec<Real>::add(BasicVec a, BasicVec b) {
+    BasicVec res;
     res.x = a.x + b.x;
     res.y = a.y + b.y;
     return res;
 }
 
-Vec Vec::sub(Vec a, Vec b) {
-    Vec res;
+template <typename Real>
+BasicVec<Real> BasicVec<Real>::sub(BasicVec a, BasicVec b) {
+    BasicVec res;
     res.x = a.x - b.x;
     res.y = a.y - b.y;
     return res;
 }
 
-Vec Vec::mult(Vec a, double scalar) {
-    Vec res;
+template <typename Real>
+BasicVec<Real> BasicVec<Real>::mult(BasicVec a, Real scalar) {
+    BasicVec res;
     res.x = a.x * scalar;
     res.y = a.y * scalar;
     return res;
 }
 
-double Vec::dot(Vec a, Vec b) {
+template <typename Real>
+Real BasicVec<Real>::dot(BasicVec a, BasicVec b) {
     return a.x * b.x + a.y * b.y;
 }
 
-double Vec::magnitude() {
-    return sqrt(pow(this->x, 2) + pow(this->y, 2));
-}
\ No newline at end of file
+template <typename Real>
+Real BasicVec<Real>::magnitude() const {
+    return std::sqrt(std::pow(this->x, 2) + std::pow(this->y, 2));
+}
+
+template class BasicVec<float>;
+template class BasicVec<double>;
\ No newline at end of file
@@ -1,23 +1,27 @@
 #ifndef COORDS_HPP
 #define COORDS_HPP
 
-class Vec {
+// 2D vector in the grid's scalar type; coords.cpp instantiates float and double
+template <typename Real>
+class BasicVec {
 public:
-    double x;
-    double y;
+    Real x;
+    Real y;
 
-    Vec(double x, double y) {
+    BasicVec(Real x, Real y) {
         this->x = x;
         this->y = y;
     }
 
-    Vec() : x(0), y(0) {}
+    BasicVec() : x(0), y(0) {}
 
-    static Vec add(Vec a, Vec b);
-    static Vec sub(Vec a, Vec b);
-    static Vec mult(Vec a, double scalar);
-    static double dot(Vec a, Vec b);
-    double magnitude();
+    static BasicVec add(BasicVec a, BasicVec b);
+    static BasicVec sub(BasicVec a, BasicVec b);
+    static BasicVec mult(BasicVec a, Real scalar);
+    static Real dot(BasicVec a, BasicVec b);
+    Real magnitude() const;
 };
 
+using Vec = BasicVec<double>;
+
 #endif // COORDS_HPP
\ No newline at end of file
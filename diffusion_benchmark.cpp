@@ -0,0 +1,127 @@
+#include "grid.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Times grid::diffusion() with plain sweeps against temporally blocked ones and checks that
+// every blocked run reproduces the plain result bit for bit.
+// Usage: DiffusionBenchmark [size] [iterations] [float|double] [tile-rows] [threads]
+//
+// Bytes per cell update come from a traffic model: a plain sweep streams before, the
+// previous iterate and the output once per iteration, 3 values per update. A depth-d block
+// streams them once per d iterations, plus the 2d - 2 rows its trapezoid overlaps.
+// The achieved rate is that model over the measured time.
+
+namespace {
+
+double modelBytesPerUpdate(int depth, int tileRows, std::size_t valueBytes) {
+    if (depth == 1) return 3.0 * valueBytes;
+    double rowsStreamed = (tileRows + 2 * depth) + (tileRows + 2 * depth - 2) + tileRows;
+    return rowsStreamed * valueBytes / (double(tileRows) * depth);
+}
+
+template <typename Real>
+bool sameField(const BasicVelocityField<Real>& a, const BasicVelocityField<Real>& b) {
+    for (int i = 0; i < a.rows(); i++) {
+        if (std::memcmp(a.u.row(i), b.u.row(i), a.cols() * sizeof(Real)) != 0) return false;
+        if (std::memcmp(a.v.row(i), b.v.row(i), a.cols() * sizeof(Real)) != 0) return false;
+    }
+    return true;
+}
+
+template <typename Real>
+int run(SimulationConfig config, int threads) {
+    const int depths[] = {1, 2, 4, 8, 16};
+    const int repeats = 5;
+    double cellUpdates = 2.0 * config.width * config.height * config.diffusionIterations;
+
+    // a smooth swirl, so every cell changes on every iteration
+    BasicVelocityField<Real> initial(config.height, config.width, 1);
+    for (int i = 0; i < config.height; i++) {
+        for (int j = 0; j < config.width; j++) {
+            initial.u(i, j) = Real(std::sin(0.05 * i) * std::cos(0.03 * j));
+            initial.v(i, j) = Real(std::cos(0.04 * i) * std::sin(0.06 * j));
+        }
+    }
+
+    std::cout << config.width << "x" << config.height << ", " << config.diffusionIterations
+              << " iterations, " << precisionName(precisionOf<Real>()) << ", tiles of "
+              << config.diffusionTileRows << " rows, " << std::max(1, threads) << " threads" << std::endl;
+    std::cout << " depth  ms/step  ns/update  model B/update  achieved GB/s  scratch KB  result" << std::endl;
+
+    BasicVelocityField<Real> reference;
+    double plainSeconds = 0;
+    for (int depth : depths) {
+        config.diffusionBlockDepth = depth;
+        BasicGrid<Real> g;
+        g.init(config);
+        g.setThreadCount(threads);
+
+        // diffusion() reports each step on cout; keep the table readable
+        double best = 1e30;
+        std::cout.setstate(std::ios::failbit);
+        for (int r = 0; r <= repeats; r++) {
+            for (int i = 0; i < config.height; i++) {
+                std::copy(initial.u.row(i), initial.u.row(i) + config.width, g.currentVelocities.u.row(i));
+                std::copy(initial.v.row(i), initial.v.row(i) + config.width, g.currentVelocities.v.row(i));
+            }
+            auto start = std::chrono::steady_clock::now();
+            g.diffusion();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (r > 0) best = std::min(best, seconds);    // the first run warms the caches
+        }
+        std::cout.clear();
+
+        bool identical = true;
+        if (depth == 1) {
+            reference = g.currentVelocities;
+            plainSeconds = best;
+        }
+        else {
+            identical = sameField(reference, g.currentVelocities);
+        }
+
+        double bytes = modelBytesPerUpdate(depth, config.diffusionTileRows, sizeof(Real));
+        std::cout << std::setw(6) << depth
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(9) << best * 1e3
+                  << std::setw(11) << best * 1e9 / cellUpdates
+                  << std::setw(16) << bytes
+                  << std::setw(15) << bytes * cellUpdates / best / 1e9
+                  << std::setw(12) << g.blockedJacobi.scratchBytes() / 1024
+                  << "  " << (identical ? "identical" : "MISMATCH");
+        if (depth > 1) std::cout << ", " << plainSeconds / best << "x";
+        std::cout << std::defaultfloat << std::endl;
+        if (!identical) return 1;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    // reports a value that does not parse the way SimulationConfig::set does
+    auto intValue = [](const std::string& name, const std::string& text, int& value) {
+        if (parseInt(text, value)) return true;
+        std::cerr << "Invalid value for " << name << ": " << text << std::endl;
+        return false;
+    };
+
+    SimulationConfig config;
+    config.width = 1024;
+    config.diffusionIterations = 48;
+    int threads = 1;
+    if (argc > 1 && !intValue("size", argv[1], config.width)) return 1;
+    config.height = config.width;
+    if (argc > 2 && !intValue("iterations", argv[2], config.diffusionIterations)) return 1;
+    std::string precision = argc > 3 ? argv[3] : "double";
+    if (argc > 4 && !intValue("tile-rows", argv[4], config.diffusionTileRows)) return 1;
+    if (argc > 5 && !intValue("threads", argv[5], threads)) return 1;
+    if (!config.validate()) return 1;
+
+    return precision == "float" ? run<float>(config, threads) : run<double>(config, threads);
+}
@@ -0,0 +1,262 @@
+#ifndef FIELD2D_HPP
+#define FIELD2D_HPP
+
+#include "coords.hpp"
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+// Every field buffer starts on a cache line, which is also wide enough for any SIMD load
+constexpr std::size_t FIELD_ALIGNMENT = 64;
+
+// Number of buffers any Field2D has allocated so far; lets callers check that a solver step allocates nothing
+inline std::atomic<std::size_t> fieldAllocationCount{0};
+
+// Non-owning view of a row-major 2D plane
+template <typename T>
+struct FieldView {
+    T* data;
+    int rows;
+    int cols;
+    std::ptrdiff_t stride;
+
+    T& operator()(int i, int j) const { return data[i * stride + j]; }
+    T* row(int i) const { return data + i * stride; }
+};
+
+// Scalar type of the CPU solver's fields, chosen at runtime; frame files record it too
+enum class Precision {
+    Float,
+    Double
+};
+
+template <typename Real>
+constexpr Precision precisionOf() {
+    return sizeof(Real) == sizeof(float) ? Precision::Float : Precision::Double;
+}
+
+inline const char* precisionName(Precision precision) {
+    return precision == Precision::Float ? "float" : "double";
+}
+
+// How the halo ring around a field is filled from its interior
+enum class BoundaryCondition {
+    Clamp,    // ghost cells repeat the nearest edge cell
+    Zero,     // ghost cells are zero
+    Periodic,     // ghost cells wrap around to the opposite edge
+    Antisymmetric // ghost cells negate the nearest edge cell, putting the zero on the cell face
+};
+
+// One scalar plane stored as a single aligned contiguous buffer, indexed (row, column).
+// An optional halo of ghost cells surrounds the interior, so (i, j) is valid for
+// -halo <= i < rows + halo and -halo <= j < cols + halo.
+template <typename T>
+class Field2D {
+public:
+    Field2D() : nRows(0), nCols(0), nHalo(0), rowStride(0), count(0), buffer(nullptr), origin(nullptr) {}
+
+    Field2D(int rows, int cols, T value = T(), int halo = 0) : Field2D() {
+        resize(rows, cols, value, halo);
+    }
+
+    Field2D(const Field2D& other) : Field2D() {
+        *this = other;
+    }
+
+    Field2D(Field2D&& other) noexcept : Field2D() {
+        swap(other);
+    }
+
+    ~Field2D() {
+        std::free(buffer);
+    }
+
+    Field2D& operator=(const Field2D& other) {
+        if (this == &other) return *this;
+        if (count != other.count) {
+            std::free(buffer);
+            buffer = allocate(other.count);
+            count = other.count;
+        }
+        nRows = other.nRows;
+        nCols = other.nCols;
+        nHalo = other.nHalo;
+        rowStride = other.rowStride;
+        origin = buffer + (other.origin - other.buffer);
+        if (count > 0) {
+            std::memcpy(buffer, other.buffer, count * sizeof(T));
+        }
+        return *this;
+    }
+
+    Field2D& operator=(Field2D&& other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void resize(int rows, int cols, T value = T(), int halo = 0) {
+        std::size_t padded = static_cast<std::size_t>(rows + 2 * halo) * (cols + 2 * halo);
+        if (padded != count) {
+            std::free(buffer);
+            buffer = allocate(padded);
+            count = padded;
+        }
+        nRows = rows;
+        nCols = cols;
+        nHalo = halo;
+        rowStride = cols + 2 * halo;
+        origin = buffer + static_cast<std::ptrdiff_t>(halo) * rowStride + halo;
+        fill(value);
+    }
+
+    // Fills interior and halo alike
+    void fill(T value) {
+        std::fill(buffer, buffer + count, value);
+    }
+
+    // Refreshes the halo ring from the interior; call after the interior changes and
+    // before a stencil reads across the edge
+    void fillBoundary(BoundaryCondition condition) {
+        if (nHalo == 0 || nRows == 0 || nCols == 0) return;
+
+        // left and right ghost columns of every interior row
+        for (int i = 0; i < nRows; i++) {
+            T* r = row(i);
+            for (int k = 1; k <= nHalo; k++) {
+                r[-k] = ghostValue(r, -k, nCols, condition);
+                r[nCols - 1 + k] = ghostValue(r, nCols - 1 + k, nCols, condition);
+            }
+        }
+
+        // top and bottom ghost rows, corners included
+        for (int k = 1; k <= nHalo; k++) {
+            copyGhostRow(-k, condition);
+            copyGhostRow(nRows - 1 + k, condition);
+        }
+    }
+
+    void swap(Field2D& other) noexcept {
+        std::swap(nRows, other.nRows);
+        std::swap(nCols, other.nCols);
+        std::swap(nHalo, other.nHalo);
+        std::swap(rowStride, other.rowStride);
+        std::swap(count, other.count);
+        std::swap(buffer, other.buffer);
+        std::swap(origin, other.origin);
+    }
+
+    T& operator()(int i, int j) { return origin[i * rowStride + j]; }
+    const T& operator()(int i, int j) const { return origin[i * rowStride + j]; }
+
+    T* row(int i) { return origin + i * rowStride; }
+    const T* row(int i) const { return origin + i * rowStride; }
+
+    // First interior element; rows are stride() elements apart
+    T* data() { return origin; }
+    const T* data() const { return origin; }
+
+    FieldView<T> view() { return { origin, nRows, nCols, rowStride }; }
+    FieldView<const T> view() const { return { origin, nRows, nCols, rowStride }; }
+
+    int rows() const { return nRows; }
+    int cols() const { return nCols; }
+    int halo() const { return nHalo; }
+    std::ptrdiff_t stride() const { return rowStride; }
+    std::size_t size() const { return static_cast<std::size_t>(nRows) * nCols; }
+
+private:
+    int nRows, nCols, nHalo;
+    std::ptrdiff_t rowStride;
+    std::size_t count;
+    T* buffer;
+    T* origin;
+
+    static T ghostValue(const T* line, int index, int length, BoundaryCondition condition) {
+        switch (condition) {
+            case BoundaryCondition::Zero: return T();
+            case BoundaryCondition::Periodic: return line[((index % length) + length) % length];
+            case BoundaryCondition::Antisymmetric: return -line[std::max(0, std::min(length - 1, index))];
+            case BoundaryCondition::Clamp:
+            default: return line[std::max(0, std::min(length - 1, index))];
+        }
+    }
+
+    void copyGhostRow(int i, BoundaryCondition condition) {
+        T* ghost = row(i) - nHalo;
+        if (condition == BoundaryCondition::Zero) {
+            std::fill(ghost, ghost + rowStride, T());
+            return;
+        }
+        int source = (condition == BoundaryCondition::Periodic)
+            ? ((i % nRows) + nRows) % nRows
+            : std::max(0, std::min(nRows - 1, i));
+        const T* sourceRow = row(source) - nHalo;
+        if (condition == BoundaryCondition::Antisymmetric) {
+            for (std::ptrdiff_t k = 0; k < rowStride; k++) {
+                ghost[k] = -sourceRow[k];
+            }
+            return;
+        }
+        std::memcpy(ghost, sourceRow, rowStride * sizeof(T));
+    }
+
+    static T* allocate(std::size_t count) {
+        if (count == 0) return nullptr;
+        // aligned_alloc requires the byte count to be a multiple of the alignment
+        std::size_t bytes = (count * sizeof(T) + FIELD_ALIGNMENT - 1) / FIELD_ALIGNMENT * FIELD_ALIGNMENT;
+        void* memory = std::aligned_alloc(FIELD_ALIGNMENT, bytes);
+        if (!memory) throw std::bad_alloc();
+        fieldAllocationCount++;
+        return static_cast<T*>(memory);
+    }
+};
+
+// 2D velocity in structure-of-arrays layout: x components in u, y components in v
+template <typename Real>
+class BasicVelocityField {
+public:
+    Field2D<Real> u;
+    Field2D<Real> v;
+
+    BasicVelocityField() = default;
+    BasicVelocityField(int rows, int cols, int halo = 0) { resize(rows, cols, halo); }
+
+    void resize(int rows, int cols, int halo = 0) {
+        u.resize(rows, cols, Real(0), halo);
+        v.resize(rows, cols, Real(0), halo);
+    }
+
+    void fillBoundary(BoundaryCondition condition) {
+        u.fillBoundary(condition);
+        v.fillBoundary(condition);
+    }
+
+    void fill(BasicVec<Real> value) {
+        u.fill(value.x);
+        v.fill(value.y);
+    }
+
+    void swap(BasicVelocityField& other) noexcept {
+        u.swap(other.u);
+        v.swap(other.v);
+    }
+
+    BasicVec<Real> at(int i, int j) const { return BasicVec<Real>(u(i, j), v(i, j)); }
+
+    void set(int i, int j, BasicVec<Real> value) {
+        u(i, j) = value.x;
+        v(i, j) = value.y;
+    }
+
+    int rows() const { return u.rows(); }
+    int cols() const { return u.cols(); }
+    bool empty() const { return u.size() == 0; }
+};
+
+using VelocityField = BasicVelocityField<double>;
+
+#endif // FIELD2D_HPP
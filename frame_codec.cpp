@@ -0,0 +1,273 @@
+#include "frame_codec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+// MSB-first bit stream over a byte vector
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : out(out) { out.clear(); }
+
+    // Appends the low bits of value; bits may be 0 to 64
+    void put(std::uint64_t value, int bits) {
+        if (bits > 32) {
+            put(value >> 32, bits - 32);
+            put(value & 0xFFFFFFFFu, 32);
+            return;
+        }
+        if (bits == 0) return;
+        accumulator = (accumulator << bits) | value;
+        filled += bits;
+        while (filled >= 8) {
+            filled -= 8;
+            out.push_back(static_cast<unsigned char>(accumulator >> filled));
+        }
+        accumulator &= (std::uint64_t(1) << filled) - 1;
+    }
+
+    void finish() {
+        if (filled > 0) {
+            out.push_back(static_cast<unsigned char>(accumulator << (8 - filled)));
+            filled = 0;
+        }
+    }
+
+private:
+    std::vector<unsigned char>& out;
+    std::uint64_t accumulator = 0;
+    int filled = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const unsigned char* data, std::size_t bytes) : data(data), bytes(bytes) {}
+
+    std::uint64_t get(int bits) {
+        if (bits > 32) {
+            std::uint64_t high = get(bits - 32);
+            return (high << 32) | get(32);
+        }
+        if (bits == 0) return 0;
+        while (available < bits) {
+            if (position == bytes) {
+                overrun = true;
+                return 0;
+            }
+            accumulator = (accumulator << 8) | data[position++];
+            available += 8;
+        }
+        available -= bits;
+        std::uint64_t value = (accumulator >> available) & ((std::uint64_t(1) << bits) - 1);
+        accumulator &= (std::uint64_t(1) << available) - 1;
+        return value;
+    }
+
+    bool failed() const { return overrun; }
+
+private:
+    const unsigned char* data;
+    std::size_t bytes;
+    std::size_t position = 0;
+    std::uint64_t accumulator = 0;
+    int available = 0;
+    bool overrun = false;
+};
+
+int leadingZeros(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int count = 0;
+    for (std::uint64_t bit = std::uint64_t(1) << 63; !(x & bit); bit >>= 1) count++;
+    return count;
+#endif
+}
+
+template <typename Stored>
+using Word = std::conditional_t<sizeof(Stored) == 4, std::uint32_t, std::uint64_t>;
+
+// Float bits as an integer that orders like the value: negative values have all bits
+// flipped, positive ones get the sign bit set
+template <typename Stored>
+std::uint64_t toOrdered(Stored value) {
+    Word<Stored> bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    Word<Stored> sign = Word<Stored>(1) << (8 * sizeof(Stored) - 1);
+    return (bits & sign) ? Word<Stored>(~bits) : Word<Stored>(bits | sign);
+}
+
+template <typename Stored>
+Stored fromOrdered(std::uint64_t ordered) {
+    Word<Stored> bits = static_cast<Word<Stored>>(ordered);
+    Word<Stored> sign = Word<Stored>(1) << (8 * sizeof(Stored) - 1);
+    bits = (bits & sign) ? Word<Stored>(bits & ~sign) : Word<Stored>(~bits);
+    Stored value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::uint64_t zigzag(std::uint64_t residual) {
+    return (residual << 1) ^ static_cast<std::uint64_t>(static_cast<std::int64_t>(residual) >> 63);
+}
+
+std::uint64_t unzigzag(std::uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+constexpr int WIDTH_BITS = 6;
+
+// Codes toInteger(value) for every value as its predicted residual
+template <typename Stored, typename ToInteger>
+void encodeIntegers(const Stored* values, std::size_t count, bool keyframe, FrameHistory& history,
+                    std::vector<unsigned char>& out, ToInteger toInteger) {
+    BitWriter writer(out);
+    int window = 0;
+
+    for (std::size_t i = 0; i < count; i++) {
+        std::uint64_t integer = toInteger(values[i]);
+        std::uint64_t residual = zigzag(integer - history.predict(i, keyframe));
+        history.current[i] = integer;
+
+        if (residual == 0) {
+            writer.put(0, 1);
+            continue;
+        }
+        int length = 64 - leadingZeros(residual);
+        // a new width costs its field, so an oversized window is kept unless it wastes more
+        if (length <= window && window - length <= WIDTH_BITS) {
+            writer.put(0b10, 2);
+            writer.put(residual, window);
+        }
+        else {
+            writer.put(0b11, 2);
+            writer.put(length - 1, WIDTH_BITS);
+            writer.put(residual, length);
+            window = length;
+        }
+    }
+    writer.finish();
+}
+
+template <typename Stored, typename FromInteger>
+bool decodeIntegers(const unsigned char* data, std::size_t bytes, std::size_t count, bool keyframe,
+                    FrameHistory& history, Stored* values, FromInteger fromInteger) {
+    BitReader reader(data, bytes);
+    int window = 0;
+
+    for (std::size_t i = 0; i < count; i++) {
+        std::uint64_t residual = 0;
+        if (reader.get(1)) {
+            if (!reader.get(1)) {
+                if (window == 0) return false;
+                residual = reader.get(window);
+            }
+            else {
+                window = static_cast<int>(reader.get(WIDTH_BITS)) + 1;
+                residual = reader.get(window);
+            }
+        }
+        if (reader.failed()) return false;
+
+        std::uint64_t integer = history.predict(i, keyframe) + unzigzag(residual);
+        history.current[i] = integer;
+        values[i] = fromInteger(integer);
+    }
+    return true;
+}
+
+// Larger values are clamped, so llround stays defined
+constexpr double QUANTIZED_LIMIT = 4611686018427387904.0;    // 2^62
+
+std::uint64_t quantize(double value, double step) {
+    double scaled = value / step;
+    // NaN has no fixed-point value; it is stored as 0
+    scaled = std::isnan(scaled) ? 0.0 : std::max(-QUANTIZED_LIMIT, std::min(QUANTIZED_LIMIT, scaled));
+    return static_cast<std::uint64_t>(std::llround(scaled));
+}
+
+}
+
+bool FrameHistory::begin(std::size_t count, bool keyframe) {
+    if (current.size() != count) {
+        if (!keyframe) return false;
+        current.assign(count, 0);
+        previous.assign(count, 0);
+        older.assign(count, 0);
+    }
+    if (keyframe) {
+        depth = 0;
+    }
+    return keyframe || depth > 0;
+}
+
+void FrameHistory::end() {
+    std::swap(older, previous);
+    std::swap(previous, current);
+    depth = std::min(depth + 1, 2);
+}
+
+const char* frameCodecName(FrameCodec codec) {
+    switch (codec) {
+        case FrameCodec::Lossless: return "lossless";
+        case FrameCodec::Quantized: return "quantized";
+        case FrameCodec::Raw:
+        default: return "raw";
+    }
+}
+
+template <typename Stored>
+void FrameEncoder<Stored>::encode(const Stored* values, std::size_t count, bool keyframe, std::vector<unsigned char>& out) {
+    if (codec == FrameCodec::Raw) {
+        out.resize(count * sizeof(Stored));
+        std::memcpy(out.data(), values, out.size());
+        return;
+    }
+    // without history to predict from, a frame can only be coded on its own
+    if (!history.begin(count, keyframe)) {
+        keyframe = true;
+        history.begin(count, true);
+    }
+    if (codec == FrameCodec::Lossless) {
+        encodeIntegers(values, count, keyframe, history, out, toOrdered<Stored>);
+    }
+    else {
+        double step = 2 * errorBound;
+        encodeIntegers(values, count, keyframe, history, out, [step](Stored value) { return quantize(value, step); });
+    }
+    history.end();
+}
+
+template <typename Stored>
+bool FrameDecoder<Stored>::decode(const unsigned char* data, std::size_t bytes, std::size_t count, bool keyframe,
+                                  Stored* values) {
+    if (codec == FrameCodec::Raw) {
+        if (bytes < count * sizeof(Stored)) return false;
+        std::memcpy(values, data, count * sizeof(Stored));
+        return true;
+    }
+    double step = 2 * errorBound;
+    bool ok = history.begin(count, keyframe);
+    if (ok && codec == FrameCodec::Lossless) {
+        ok = decodeIntegers(data, bytes, count, keyframe, history, values, fromOrdered<Stored>);
+    }
+    else if (ok) {
+        ok = decodeIntegers(data, bytes, count, keyframe, history, values, [step](std::uint64_t q) {
+            return Stored(double(static_cast<std::int64_t>(q)) * step);
+        });
+    }
+    if (ok) {
+        history.end();
+    }
+    else {
+        history.reset();
+    }
+    return ok;
+}
+
+template class FrameEncoder<float>;
+template class FrameEncoder<double>;
+template class FrameDecoder<float>;
+template class FrameDecoder<double>;
@@ -0,0 +1,86 @@
+#ifndef FRAME_CODEC_HPP
+#define FRAME_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How each frame's values are stored in a frame file
+enum class FrameCodec : std::uint32_t {
+    Raw = 0,        // the values as they are
+    Lossless = 1,   // predicted residuals of the float bits, fpzip/Gorilla-style width coding
+    Quantized = 2   // fixed point with step 2 * errorBound, residuals coded like lossless
+};
+
+const char* frameCodecName(FrameCodec codec);
+
+// Both compressed codecs work on integers: the float bits mapped so that their order is the
+// order of the values (lossless), or the fixed-point values (quantized). Each value is
+// predicted by extrapolating the same value's last two frames linearly, which is exact for
+// the interpolated in-betweens and close for smooth simulation steps; the frame after a
+// keyframe uses the previous value alone. A keyframe has no previous frame and extrapolates
+// from the same component of the two cells to its left instead, so it decodes on its own.
+// All prediction arithmetic is integer, so files decode identically on every platform.
+//
+// The zigzag-mapped residual is written as one 0 bit when zero; otherwise as "10" and the
+// residual in as many bits as the last one that needed a new width, when it fits, or as
+// "11", a 6-bit width and the residual in that many bits.
+//
+// Lossless values come back bit for bit. Quantized ones are q = round(value / (2 * errorBound)),
+// so every value comes back within errorBound (plus the rounding of the reconstruction to
+// Stored); where the flow is still, most residuals cost one bit.
+
+// What encoder and decoder remember of the frames since the last keyframe
+struct FrameHistory {
+    std::vector<std::uint64_t> current;     // this frame, as it is coded
+    std::vector<std::uint64_t> previous;
+    std::vector<std::uint64_t> older;
+    int depth = 0;                          // frames held in previous and older
+
+    // Prepares for a frame of count values; false if a frame that needs history has none
+    bool begin(std::size_t count, bool keyframe);
+
+    std::uint64_t predict(std::size_t i, bool keyframe) const {
+        if (keyframe) {
+            return i >= 4 ? 2 * current[i - 2] - current[i - 4] : i >= 2 ? current[i - 2] : 0;
+        }
+        return depth >= 2 ? 2 * previous[i] - older[i] : previous[i];
+    }
+
+    // Makes the frame just coded the previous one
+    void end();
+    void reset() { depth = 0; }
+};
+
+// Encodes frames in order. Keeps the previous frame's state, so the decoder must see the
+// same sequence of frames starting from the same keyframe.
+template <typename Stored>
+class FrameEncoder {
+public:
+    FrameEncoder(FrameCodec codec, double errorBound) : codec(codec), errorBound(errorBound) {}
+
+    // Replaces out with the encoded count values
+    void encode(const Stored* values, std::size_t count, bool keyframe, std::vector<unsigned char>& out);
+
+private:
+    FrameCodec codec;
+    double errorBound;
+    FrameHistory history;
+};
+
+template <typename Stored>
+class FrameDecoder {
+public:
+    FrameDecoder(FrameCodec codec, double errorBound) : codec(codec), errorBound(errorBound) {}
+
+    // Decodes count values; false if the data ends early or is malformed. After a failure the
+    // next frame must be a keyframe.
+    bool decode(const unsigned char* data, std::size_t bytes, std::size_t count, bool keyframe, Stored* values);
+
+private:
+    FrameCodec codec;
+    double errorBound;
+    FrameHistory history;
+};
+
+#endif // FRAME_CODEC_HPP
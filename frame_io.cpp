@@ -0,0 +1,137 @@
+#include "frame_io.hpp"
+#include "frame_writer.hpp"
+#include "mapped_frame_file.hpp"
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+namespace {
+
+// Splits one stored row of interleaved Stored values into the u and v rows
+template <typename Stored, typename Real>
+void copyRow(const unsigned char* stored, Real* u, Real* v, int width) {
+    for (int j = 0; j < width; j++) {
+        Stored cell[2];
+        memcpy(cell, stored + 2 * j * sizeof(Stored), sizeof(cell));
+        u[j] = Real(cell[0]);
+        v[j] = Real(cell[1]);
+    }
+}
+
+}
+
+bool parseFrameFileHeader(const unsigned char* data, size_t size, FrameFileHeader& header) {
+    size_t offset = 0;
+    auto take = [&](void* value, size_t bytes) {
+        if (offset + bytes > size) return false;
+        memcpy(value, data + offset, bytes);
+        offset += bytes;
+        return true;
+    };
+
+    bool ok;
+    if (size >= sizeof(FRAME_FILE_MAGIC) && memcmp(data, FRAME_FILE_MAGIC, sizeof(FRAME_FILE_MAGIC)) == 0) {
+        uint32_t bytesPerValue = 0;
+        offset = sizeof(FRAME_FILE_MAGIC);
+        ok = take(&header.version, sizeof(header.version)) && take(&bytesPerValue, sizeof(bytesPerValue));
+        if (ok && (header.version < 1 || header.version > FRAME_FILE_VERSION)) {
+            cerr << "Error: unsupported frame file version " << header.version << endl;
+            return false;
+        }
+        if (ok && bytesPerValue != sizeof(float) && bytesPerValue != sizeof(double)) {
+            cerr << "Error: unsupported frame value size " << bytesPerValue << endl;
+            return false;
+        }
+        header.precision = bytesPerValue == sizeof(float) ? Precision::Float : Precision::Double;
+    }
+    else {
+        // legacy layout: the first word is already the frame count
+        ok = true;
+        header.version = 0;
+        header.precision = Precision::Double;
+    }
+
+    ok = ok && take(&header.numFrames, sizeof(int)) && take(&header.width, sizeof(int)) && take(&header.height, sizeof(int));
+    if (ok && header.chunked()) {
+        uint32_t codec = 0;
+        uint32_t keyframeInterval = 0;
+        ok = take(&codec, sizeof(codec)) && take(&keyframeInterval, sizeof(keyframeInterval)) &&
+             take(&header.errorBound, sizeof(header.errorBound)) && take(&header.indexOffset, sizeof(header.indexOffset));
+        if (ok && codec > static_cast<uint32_t>(FrameCodec::Quantized)) {
+            cerr << "Error: unsupported frame codec " << codec << endl;
+            return false;
+        }
+        header.codec = static_cast<FrameCodec>(codec);
+        header.keyframeInterval = static_cast<int>(keyframeInterval);
+        ok = ok && header.keyframeInterval > 0 && (header.codec != FrameCodec::Quantized || header.errorBound > 0);
+    }
+    if (ok && header.version >= 3) {
+        uint32_t tileSize = 0;
+        uint32_t inBetweens = 0;
+        ok = take(&tileSize, sizeof(tileSize)) && take(&inBetweens, sizeof(inBetweens)) && tileSize <= (1u << 16) &&
+             inBetweens <= (1u << 16);
+        header.tileSize = static_cast<int>(tileSize);
+        header.inBetweens = static_cast<int>(inBetweens);
+    }
+    if (!ok || header.numFrames < 0 || header.width <= 0 || header.height <= 0) {
+        cerr << "Error: frame file header is truncated or invalid" << endl;
+        return false;
+    }
+    header.dataOffset = offset;
+    return true;
+}
+
+template <typename Real>
+bool writeFrames(const string& filename, const vector<BasicVelocityField<Real>>& frames, int width, int height,
+                 double frameInterval, int inBetweens) {
+    FrameWriter writer;
+    FrameWriter::Options options;
+    options.inBetweens = inBetweens;
+    if (!writer.open(filename, width, height, precisionOf<Real>(), options)) {
+        return false;
+    }
+    for (size_t f = 0; f < frames.size(); f++) {
+        writer.writeFrame(frames[f], f * frameInterval);
+    }
+    return writer.close();
+}
+
+template <typename Real>
+bool readFrames(const string& filename, vector<BasicVelocityField<Real>>& frames, int& width, int& height) {
+    MappedFrameFile file;
+    if (!file.open(filename)) {
+        return false;
+    }
+    if (file.precision() != precisionOf<Real>()) {
+        cout << "Converting " << precisionName(file.precision()) << " frames to "
+             << precisionName(precisionOf<Real>()) << endl;
+    }
+
+    width = file.width();
+    height = file.height();
+    frames.clear();
+    frames.resize(file.frameCount());
+    for (int f = 0; f < file.frameCount(); f++) {
+        FrameView view = file.frame(f);
+        frames[f].resize(height, width);
+        for (int i = 0; i < height; i++) {
+            if (view.precision == Precision::Float) {
+                copyRow<float>(view.row(i), frames[f].u.row(i), frames[f].v.row(i), width);
+            }
+            else {
+                copyRow<double>(view.row(i), frames[f].u.row(i), frames[f].v.row(i), width);
+            }
+        }
+        if ((f + 1) % 100 == 0) {
+            cout << "Read " << (f + 1) << " frames..." << endl;
+        }
+    }
+
+    cout << "Successfully read " << file.frameCount() << " frames from " << filename << endl;
+    return true;
+}
+
+template bool writeFrames<float>(const string&, const vector<BasicVelocityField<float>>&, int, int, double, int);
+template bool writeFrames<double>(const string&, const vector<BasicVelocityField<double>>&, int, int, double, int);
+template bool readFrames<float>(const string&, vector<BasicVelocityField<float>>&, int&, int&);
+template bool readFrames<double>(const string&, vector<BasicVelocityField<double>>&, int&, int&);
@@ -0,0 +1,92 @@
+#ifndef FRAME_IO_HPP
+#define FRAME_IO_HPP
+
+#include "field2d.hpp"
+#include "frame_codec.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Velocity frame files. Layout, all little-endian:
+//   char magic[4] = "NSVF", uint32 version, uint32 bytes per value (4 = float, 8 = double),
+//   int32 numFrames, int32 width, int32 height,
+// version 2 continues with
+//   uint32 codec (FrameCodec), uint32 keyframe interval, double error bound, uint64 index offset,
+//   then every frame as a uint64 payload size and the payload, zero-padded to a multiple of
+//   8 bytes. Frame k is a keyframe when k % keyframe interval == 0.
+//   The footer index follows the last frame: char magic[4] = "NSVI", uint32 entry count,
+//   then one FrameIndexEntry per frame. The index offset is 0 when the writer did not finish;
+//   the frames are then found by walking their sizes.
+// version 3 continues with
+//   uint32 tile size, uint32 in-betweens.
+//   In-betweens is how many linear blends a player computes between consecutive stored
+//   frames (see interpolated_frames.hpp); 0 plays the stored frames alone.
+//   A tile size of 0 leaves frames whole. Otherwise a frame is cut into tile size x tile size
+//   tiles (smaller at the right and bottom edges), and its payload is uint64 offsets[tiles + 1]
+//   into the tile data that follows, then each tile coded on its own, tile rows top to
+//   bottom. A tile is predicted only from the same tile, so a region decodes only the
+//   tiles it overlaps.
+// A frame's (or tile's) values are its rows with cells interleaved (vx, vy); version 1
+// stores them raw, one frame after another, and later versions store them through the
+// codec (see frame_codec.hpp).
+// Files from before the header start directly at numFrames and always hold doubles; they
+// are still read. Reading converts to the caller's precision when the file's differs.
+constexpr char FRAME_FILE_MAGIC[4] = {'N', 'S', 'V', 'F'};
+constexpr std::uint32_t FRAME_FILE_VERSION = 3;
+constexpr char FRAME_INDEX_MAGIC[4] = {'N', 'S', 'V', 'I'};
+
+// Where a frame is and what it holds, so readers can seek and filter without decoding
+struct FrameIndexEntry {
+    std::uint64_t offset = 0;          // of the frame's payload
+    std::uint64_t payloadBytes = 0;
+    double time = 0;                   // simulated time of the frame
+    float minU = 0, maxU = 0;
+    float minV = 0, maxV = 0;
+    float maxSpeed = 0;
+    std::uint32_t flags = 0;           // FRAME_HAS_STATISTICS when the min/max fields are known
+};
+static_assert(sizeof(FrameIndexEntry) == 48, "FrameIndexEntry is stored as is");
+
+constexpr std::uint32_t FRAME_HAS_STATISTICS = 1;
+
+struct FrameFileHeader {
+    std::uint32_t version = 0;    // 0 for a legacy file without magic
+    Precision precision = Precision::Double;
+    int numFrames = 0;
+    int width = 0;
+    int height = 0;
+    FrameCodec codec = FrameCodec::Raw;
+    int keyframeInterval = 1;
+    double errorBound = 0;        // quantized codec only
+    std::uint64_t indexOffset = 0;
+    int tileSize = 0;             // 0 for whole frames
+    int inBetweens = 0;           // blends to play between stored frames
+    std::size_t dataOffset = 0;    // byte offset of the first frame
+
+    std::size_t bytesPerValue() const { return precision == Precision::Float ? sizeof(float) : sizeof(double); }
+    std::size_t frameBytes() const { return std::size_t(2) * width * height * bytesPerValue(); }
+    bool chunked() const { return version >= 2; }    // frames carry a size and may be compressed
+    bool isKeyframe(int index) const { return index % keyframeInterval == 0; }
+    bool tiled() const { return tileSize > 0; }
+    int tilesX() const { return tiled() ? (width + tileSize - 1) / tileSize : 1; }
+    int tilesY() const { return tiled() ? (height + tileSize - 1) / tileSize : 1; }
+    int tileCount() const { return tilesX() * tilesY(); }
+};
+
+// Parses the header at the start of a file's first size bytes. Prints the problem and returns
+// false if it is truncated or describes an unknown version, value size or dimensions.
+bool parseFrameFileHeader(const unsigned char* data, std::size_t size, FrameFileHeader& header);
+
+// Writes frames (each width x height) in Real's precision through a FrameWriter; frame k is
+// stamped with time k * frameInterval, and the header asks players for inBetweens blends
+template <typename Real>
+bool writeFrames(const std::string& filename, const std::vector<BasicVelocityField<Real>>& frames, int width, int height,
+                 double frameInterval = 1, int inBetweens = 0);
+
+// Replaces frames with copies of the file's frames, sized from the file, and reports its
+// dimensions. To read frames in place without copying, use MappedFrameFile.
+template <typename Real>
+bool readFrames(const std::string& filename, std::vector<BasicVelocityField<Real>>& frames, int& width, int& height);
+
+#endif // FRAME_IO_HPP
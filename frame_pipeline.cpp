@@ -0,0 +1,173 @@
+#include "frame_pipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+namespace {
+
+const char* const STAGE_NAMES[] = { "simulate", "interpolate", "encode", "write" };
+
+double now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Row copies, so a frame with halos lands in a halo-free pipeline frame
+template <typename Real>
+void copyFrame(const BasicVelocityField<Real>& from, BasicVelocityField<Real>& to) {
+    for (int i = 0; i < from.rows(); i++) {
+        std::copy(from.u.row(i), from.u.row(i) + from.cols(), to.u.row(i));
+        std::copy(from.v.row(i), from.v.row(i) + from.cols(), to.v.row(i));
+    }
+}
+
+}
+
+template <typename Real>
+void FramePipeline<Real>::start(FrameWriter& frameWriter, int rows, int cols, const Options& options) {
+    finish();
+    writer = &frameWriter;
+    interpolator.inBetweens = std::max(0, options.inBetweens);
+    interpolator.resize(rows, cols);
+
+    // the end marker needs a place in each queue besides every frame
+    int depth = std::max(1, options.queueDepth);
+    simulated.resize(depth);
+    interpolated.resize(depth);
+    freeSimulated.reset(depth);
+    freeInterpolated.reset(depth);
+    toInterpolate.reset(depth + 1);
+    toEncode.reset(depth + 1);
+    for (int f = 0; f < depth; f++) {
+        simulated[f].resize(rows, cols);
+        interpolated[f].resize(rows, cols);
+        freeSimulated.tryPush(f);
+        freeInterpolated.tryPush(f);
+    }
+    for (StageCounters& c : counters) {
+        c.reset();
+    }
+
+    interpolateThread = std::thread([this] { interpolateLoop(); });
+    encodeThread = std::thread([this] { encodeLoop(); });
+    lastConsumed = now();
+}
+
+template <typename Real>
+void FramePipeline<Real>::seed(const BasicVelocityField<Real>& frame, double time) {
+    // the interpolation thread first touches the interpolator after popping a frame, which
+    // orders this before it
+    interpolator.seed(frame, time);
+}
+
+template <typename Real>
+void FramePipeline<Real>::consume(const BasicVelocityField<Real>& frame, double time) {
+    StageCounters& c = counters[static_cast<int>(Stage::Simulation)];
+    double started = now();
+    c.addBusy(started - lastConsumed);
+
+    int slot;
+    c.addWait(waitUntil([&] { return freeSimulated.tryPop(slot); }));
+    copyFrame(frame, simulated[slot]);
+    toInterpolate.tryPush(Item{ slot, time });
+    c.addItem();
+    lastConsumed = now();
+}
+
+template <typename Real>
+void FramePipeline<Real>::emit(const BasicVelocityField<Real>& frame, double time) {
+    int slot;
+    emitWait += waitUntil([&] { return freeInterpolated.tryPop(slot); });
+    copyFrame(frame, interpolated[slot]);
+    toEncode.tryPush(Item{ slot, time });
+}
+
+template <typename Real>
+void FramePipeline<Real>::interpolateLoop() {
+    StageCounters& c = counters[static_cast<int>(Stage::Interpolation)];
+    EncodeSink sink(*this);
+    while (true) {
+        Item item;
+        c.addWait(waitUntil([&] { return toInterpolate.tryPop(item); }));
+        if (item.slot < 0) break;
+        c.sampleQueueDepth(toInterpolate.size() + 1);
+
+        double started = now();
+        emitWait = 0;
+        interpolator.push(simulated[item.slot], item.time, sink);
+        freeSimulated.tryPush(item.slot);
+        double seconds = now() - started;
+        c.addBusy(seconds - emitWait);
+        c.addWait(emitWait);
+        c.addItem();
+    }
+    toEncode.tryPush(Item());
+}
+
+template <typename Real>
+void FramePipeline<Real>::encodeLoop() {
+    StageCounters& c = counters[static_cast<int>(Stage::Encoding)];
+    while (true) {
+        Item item;
+        c.addWait(waitUntil([&] { return toEncode.tryPop(item); }));
+        if (item.slot < 0) break;
+        c.sampleQueueDepth(toEncode.size() + 1);
+
+        // the writer's own wait for a free buffer is backpressure from the write stage
+        double started = now();
+        double stalled = writer->stalledSeconds();
+        writer->writeFrame(interpolated[item.slot], item.time);
+        freeInterpolated.tryPush(item.slot);
+        stalled = writer->stalledSeconds() - stalled;
+        c.addBusy(now() - started - stalled);
+        c.addWait(stalled);
+        c.addItem();
+    }
+}
+
+template <typename Real>
+void FramePipeline<Real>::finish() {
+    if (!interpolateThread.joinable()) return;
+    // every frame may be queued, but the queues keep a place for the end marker
+    toInterpolate.tryPush(Item());
+    interpolateThread.join();
+    encodeThread.join();
+}
+
+template <typename Real>
+StageStats FramePipeline<Real>::stats(Stage stage) const {
+    if (stage == Stage::Writing) {
+        StageStats s = writer ? writer->ioStats() : StageStats();
+        s.name = STAGE_NAMES[static_cast<int>(Stage::Writing)];
+        return s;
+    }
+    return counters[static_cast<int>(stage)].stats(STAGE_NAMES[static_cast<int>(stage)]);
+}
+
+template <typename Real>
+void FramePipeline<Real>::printStats(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "Pipeline stage      items    busy s    wait s    items/s   queue mean/max" << std::endl;
+    int slowest = 0;
+    StageStats all[STAGE_COUNT];
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        all[s] = stats(static_cast<Stage>(s));
+        if (all[s].busySeconds > all[slowest].busySeconds) slowest = s;
+    }
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        const StageStats& st = all[s];
+        out << "  " << std::left << std::setw(14) << st.name << std::right << std::setw(9) << st.items
+            << std::setw(10) << st.busySeconds << std::setw(10) << st.waitSeconds
+            << std::setw(11) << std::setprecision(1) << st.itemsPerSecond() << std::setprecision(3);
+        if (s == static_cast<int>(Stage::Simulation)) out << "          -";
+        else out << std::setw(11) << std::setprecision(2) << st.meanQueueDepth << std::setprecision(3) << "/" << st.maxQueueDepth;
+        if (s == slowest) out << "   (slowest)";
+        out << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+template class FramePipeline<float>;
+template class FramePipeline<double>;
@@ -0,0 +1,94 @@
+#ifndef FRAME_PIPELINE_HPP
+#define FRAME_PIPELINE_HPP
+
+#include "frame_sink.hpp"
+#include "spsc_queue.hpp"
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Runs the output of a simulation as a pipeline instead of in line with the step loop:
+//   simulate (the thread calling consume) -> interpolate -> encode -> write (FrameWriter's
+//   I/O thread)
+// Each stage has its own thread and hands frames to the next through a bounded lock-free
+// queue of preallocated frames. A stage that gets ahead waits for a frame to come back, so
+// memory stays fixed and the run goes at the pace of its slowest stage rather than the sum
+// of all of them. The file is the same, byte for byte, as streaming through FrameInterpolator
+// into a FrameWriterSink.
+template <typename Real>
+class FramePipeline : public FrameSink<Real> {
+public:
+    struct Options {
+        int queueDepth = 4;      // frames each stage can have in flight towards the next
+        int inBetweens = 0;      // blends the interpolation stage writes between frames
+    };
+
+    enum class Stage { Simulation, Interpolation, Encoding, Writing };
+    static constexpr int STAGE_COUNT = 4;
+
+    FramePipeline() = default;
+    ~FramePipeline() { finish(); }
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // Starts the interpolation and encoding threads for frames of rows x cols. writer must be
+    // open, and is written only by the encoding thread until finish().
+    void start(FrameWriter& writer, int rows, int cols, const Options& options);
+
+    // A restarted run: blends towards the first consumed frame start from frame. Call before it.
+    void seed(const BasicVelocityField<Real>& frame, double time);
+
+    // The simulation stage: copies frame into the pipeline, waiting if every frame is in flight
+    void consume(const BasicVelocityField<Real>& frame, double time) override;
+
+    // Waits until every consumed frame has reached the writer and stops the threads; the
+    // writer can be closed after this
+    void finish();
+
+    // Counters of a stage, readable while the pipeline runs. Items are frames, except for
+    // Writing, which counts the writer's buffers.
+    StageStats stats(Stage stage) const;
+
+    // One line per stage: items, busy and waiting time, throughput and queue depths
+    void printStats(std::ostream& out) const;
+
+private:
+    struct Item {
+        int slot = -1;           // -1 ends the stream
+        double time = 0;
+    };
+
+    // Hands the interpolator's output to the encoding stage
+    class EncodeSink : public FrameSink<Real> {
+    public:
+        explicit EncodeSink(FramePipeline& pipeline) : pipeline(pipeline) {}
+        void consume(const BasicVelocityField<Real>& frame, double time) override { pipeline.emit(frame, time); }
+
+    private:
+        FramePipeline& pipeline;
+    };
+
+    FrameWriter* writer = nullptr;
+    FrameInterpolator<Real> interpolator;
+
+    // frames as simulated, and as interpolated; each is owned by whichever stage holds its index
+    std::vector<BasicVelocityField<Real>> simulated;
+    std::vector<BasicVelocityField<Real>> interpolated;
+    SpscQueue<int> freeSimulated;
+    SpscQueue<int> freeInterpolated;
+    SpscQueue<Item> toInterpolate;
+    SpscQueue<Item> toEncode;
+
+    std::thread interpolateThread;
+    std::thread encodeThread;
+    StageCounters counters[STAGE_COUNT - 1];
+    double lastConsumed = 0;     // steady clock seconds when consume last returned
+    double emitWait = 0;         // interpolation thread: waiting for free frames during one push
+
+    void emit(const BasicVelocityField<Real>& frame, double time);
+    void interpolateLoop();
+    void encodeLoop();
+};
+
+#endif // FRAME_PIPELINE_HPP
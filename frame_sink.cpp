@@ -0,0 +1,50 @@
+#include "frame_sink.hpp"
+#include "stencil_kernels.hpp"
+
+template <typename Real>
+void FrameInterpolator<Real>::resize(int rows, int cols) {
+    previous.resize(rows, cols);
+    inBetween.resize(rows, cols);
+    havePrevious = false;
+}
+
+template <typename Real>
+void FrameInterpolator<Real>::push(const BasicVelocityField<Real>& frame, double time, FrameSink<Real>& sink) {
+    if (havePrevious) {
+        for (int j = 0; j < inBetweens; j++) {
+            blend(previous, frame, j, inBetweens, inBetween);
+            sink.consume(inBetween, previousTime + (time - previousTime) * (j + 1) / (inBetweens + 1));
+        }
+    }
+    sink.consume(frame, time);
+    seed(frame, time);
+}
+
+template <typename Real>
+void FrameInterpolator<Real>::seed(const BasicVelocityField<Real>& frame, double time) {
+    // row copies, so the held frame keeps its own (halo-free) layout and buffer
+    int rows = frame.rows();
+    int cols = frame.cols();
+    if (previous.rows() != rows || previous.cols() != cols) {
+        resize(rows, cols);
+    }
+    for (int i = 0; i < rows; i++) {
+        std::copy(frame.u.row(i), frame.u.row(i) + cols, previous.u.row(i));
+        std::copy(frame.v.row(i), frame.v.row(i) + cols, previous.v.row(i));
+    }
+    previousTime = time;
+    havePrevious = true;
+}
+
+template <typename Real>
+void FrameInterpolator<Real>::blend(const BasicVelocityField<Real>& from, const BasicVelocityField<Real>& to,
+                                    int j, int n, BasicVelocityField<Real>& out) {
+    const StencilKernels<Real>& kernels = stencilKernels<Real>(detectSimdLevel());
+    for (int r = 0; r < from.rows(); r++) {
+        kernels.blendRow(out.u.row(r), from.u.row(r), to.u.row(r), from.cols(), Real(n - j), Real(j + 1), Real(n + 1));
+        kernels.blendRow(out.v.row(r), from.v.row(r), to.v.row(r), from.cols(), Real(n - j), Real(j + 1), Real(n + 1));
+    }
+}
+
+template class FrameInterpolator<float>;
+template class FrameInterpolator<double>;
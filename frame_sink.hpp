@@ -0,0 +1,71 @@
+#ifndef FRAME_SINK_HPP
+#define FRAME_SINK_HPP
+
+#include "field2d.hpp"
+#include "frame_writer.hpp"
+#include <vector>
+
+// Receives output frames one at a time, with the simulated time each shows. A frame is only
+// valid during the call, so a sink that keeps it must copy it.
+template <typename Real>
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+    virtual void consume(const BasicVelocityField<Real>& frame, double time) = 0;
+};
+
+// Streams frames into an open FrameWriter
+template <typename Real>
+class FrameWriterSink : public FrameSink<Real> {
+public:
+    explicit FrameWriterSink(FrameWriter& writer) : writer(writer) {}
+    void consume(const BasicVelocityField<Real>& frame, double time) override { writer.writeFrame(frame, time); }
+
+private:
+    FrameWriter& writer;
+};
+
+// Keeps copies of every frame, for callers that want the whole run in memory
+template <typename Real>
+class FrameCollector : public FrameSink<Real> {
+public:
+    explicit FrameCollector(std::vector<BasicVelocityField<Real>>& frames) : frames(frames) {}
+    void consume(const BasicVelocityField<Real>& frame, double) override { frames.push_back(frame); }
+
+private:
+    std::vector<BasicVelocityField<Real>>& frames;
+};
+
+// Turns simulation frames into the output sequence: each frame after the first is preceded
+// by inBetweens linear blends from the previous one. Only the previous frame and one blend
+// buffer are held, so memory does not grow with the run.
+template <typename Real>
+class FrameInterpolator {
+public:
+    int inBetweens = 10;
+
+    // Allocates the held frames; push() allocates nothing for frames of this size
+    void resize(int rows, int cols);
+
+    // Sends the in-betweens since the last pushed frame, then frame itself, to sink. The
+    // in-betweens are stamped with times evenly spaced between the two frames'.
+    void push(const BasicVelocityField<Real>& frame, double time, FrameSink<Real>& sink);
+
+    // Makes frame the previous one without sending it, as if it had just been pushed
+    void seed(const BasicVelocityField<Real>& frame, double time);
+
+    // Forgets the previous frame, so the next push starts a new sequence
+    void reset() { havePrevious = false; }
+
+    // In-between j (0-based) of n between from and to, through the SIMD blend kernel
+    static void blend(const BasicVelocityField<Real>& from, const BasicVelocityField<Real>& to, int j, int n,
+                      BasicVelocityField<Real>& out);
+
+private:
+    BasicVelocityField<Real> previous;
+    BasicVelocityField<Real> inBetween;
+    double previousTime = 0;
+    bool havePrevious = false;
+};
+
+#endif // FRAME_SINK_HPP
@@ -0,0 +1,462 @@
+#include "frame_writer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// O_DIRECT needs buffer addresses, sizes and file offsets aligned to the device block size;
+// 4096 covers every common device
+constexpr std::size_t IO_ALIGNMENT = 4096;
+
+// magic, version, value size, frame count, width, height, codec, keyframe interval, error bound
+constexpr long FRAME_INDEX_OFFSET_POSITION = 32 + sizeof(double);
+
+int openForWriting(const std::string& path, bool directIO) {
+#ifdef _WIN32
+    (void)directIO;
+    return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    if (directIO) flags |= O_DIRECT;
+#else
+    (void)directIO;
+#endif
+    return ::open(path.c_str(), flags, 0644);
+#endif
+}
+
+long writeSome(int fd, const unsigned char* data, std::size_t bytes) {
+#ifdef _WIN32
+    return _write(fd, data, static_cast<unsigned int>(std::min<std::size_t>(bytes, 1u << 30)));
+#else
+    return static_cast<long>(::write(fd, data, bytes));
+#endif
+}
+
+bool syncData(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#elif defined(__APPLE__)
+    return fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
+bool writeAt(int fd, long offset, const void* data, std::size_t bytes) {
+#ifdef _WIN32
+    return _lseek(fd, offset, SEEK_SET) == offset && _write(fd, data, static_cast<unsigned int>(bytes)) == static_cast<int>(bytes);
+#else
+    return pwrite(fd, data, bytes, offset) == static_cast<ssize_t>(bytes);
+#endif
+}
+
+void closeFile(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Running min/max of the frame being written, for its index entry
+template <typename Real>
+struct FrameStatistics {
+    Real minU = std::numeric_limits<Real>::max();
+    Real maxU = std::numeric_limits<Real>::lowest();
+    Real minV = std::numeric_limits<Real>::max();
+    Real maxV = std::numeric_limits<Real>::lowest();
+    Real maxSpeedSquared = 0;
+
+    void store(FrameIndexEntry& entry) const {
+        entry.minU = float(minU);
+        entry.maxU = float(maxU);
+        entry.minV = float(minV);
+        entry.maxV = float(maxV);
+        entry.maxSpeed = float(std::sqrt(maxSpeedSquared));
+        entry.flags |= FRAME_HAS_STATISTICS;
+    }
+};
+
+// Interleaves one row of u and v into Stored values
+template <typename Stored, typename Real>
+void interleaveRow(unsigned char* out, const Real* u, const Real* v, int width, FrameStatistics<Real>& stats) {
+    Stored* values = reinterpret_cast<Stored*>(out);
+    for (int j = 0; j < width; j++) {
+        values[2 * j] = Stored(u[j]);
+        values[2 * j + 1] = Stored(v[j]);
+        stats.minU = std::min(stats.minU, u[j]);
+        stats.maxU = std::max(stats.maxU, u[j]);
+        stats.minV = std::min(stats.minV, v[j]);
+        stats.maxV = std::max(stats.maxV, v[j]);
+        stats.maxSpeedSquared = std::max(stats.maxSpeedSquared, u[j] * u[j] + v[j] * v[j]);
+    }
+}
+
+}
+
+FrameWriter::~FrameWriter() {
+    if (isOpen()) close(true);
+}
+
+bool FrameWriter::open(const std::string& filename, int frameWidth, int frameHeight, Precision framePrecision,
+                       const Options& writerOptions) {
+    if (isOpen()) close(true);
+
+    options = writerOptions;
+    options.bufferBytes = std::max(IO_ALIGNMENT, (options.bufferBytes + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT);
+    options.queueDepth = std::max(1, options.queueDepth);
+    options.keyframeInterval = std::max(1, options.keyframeInterval);
+    options.tileSize = std::max(0, options.tileSize);
+    options.inBetweens = std::max(0, std::min(options.inBetweens, 1 << 16));
+    directIO = options.directIO;
+    if (options.codec == FrameCodec::Quantized && !(options.errorBound > 0)) {
+        std::cerr << "Error: the quantized codec needs a positive error bound" << std::endl;
+        return false;
+    }
+
+    fd = openForWriting(filename, directIO);
+    if (fd < 0 && directIO) {
+        // tmpfs and some network filesystems refuse O_DIRECT
+        std::cerr << "O_DIRECT unavailable for " << filename << ", using buffered writes" << std::endl;
+        directIO = false;
+        fd = openForWriting(filename, false);
+    }
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file " << filename << " for writing" << std::endl;
+        return false;
+    }
+
+    path = filename;
+    width = frameWidth;
+    height = frameHeight;
+    precision = framePrecision;
+    frameCount = 0;
+    stallCount = 0;
+    stallSeconds = 0;
+    bytesWritten = 0;
+    payloadBytes = 0;
+    appended = 0;
+    index.clear();
+    ioSeconds = 0;
+    finishing = false;
+    failed = false;
+    ioCounters.reset();
+
+    // one buffer is being filled while queueDepth are queued or being written
+    buffers.resize(options.queueDepth + 1);
+    freeBuffers.reset(buffers.size());
+    fullBuffers.reset(buffers.size());
+    for (int b = 0; b < static_cast<int>(buffers.size()); b++) {
+        buffers[b].data = static_cast<unsigned char*>(std::aligned_alloc(IO_ALIGNMENT, options.bufferBytes));
+        if (!buffers[b].data) {
+            std::cerr << "Error: Could not allocate " << buffers.size() << " write buffers of "
+                      << options.bufferBytes / 1e6 << " MB for " << filename << std::endl;
+            release();
+            closeFile(fd);
+            fd = -1;
+            return false;
+        }
+        buffers[b].used = 0;
+        freeBuffers.tryPush(b);
+    }
+    freeBuffers.tryPop(current);
+    rowBuffer.resize(2 * static_cast<std::size_t>(width) * (precision == Precision::Float ? sizeof(float) : sizeof(double)));
+    if (options.codec != FrameCodec::Raw || options.tileSize > 0) {
+        frameBuffer.resize(rowBuffer.size() * height / sizeof(double) + 1);
+    }
+    floatEncoder = FrameEncoder<float>(options.codec, options.errorBound);
+    doubleEncoder = FrameEncoder<double>(options.codec, options.errorBound);
+    floatTileEncoders.clear();
+    doubleTileEncoders.clear();
+    if (options.tileSize > 0) {
+        int tiles = ((width + options.tileSize - 1) / options.tileSize) * ((height + options.tileSize - 1) / options.tileSize);
+        if (precision == Precision::Float) {
+            floatTileEncoders.assign(tiles, floatEncoder);
+        }
+        else {
+            doubleTileEncoders.assign(tiles, doubleEncoder);
+        }
+        tileBuffer.resize(2 * static_cast<std::size_t>(options.tileSize) * options.tileSize);
+    }
+
+    // the frame count and index offset are written as 0 and patched by close()
+    std::uint32_t version = FRAME_FILE_VERSION;
+    std::uint32_t bytesPerValue = precision == Precision::Float ? sizeof(float) : sizeof(double);
+    int placeholderCount = 0;
+    std::uint32_t codec = static_cast<std::uint32_t>(options.codec);
+    std::uint32_t keyframeInterval = static_cast<std::uint32_t>(options.keyframeInterval);
+    std::uint64_t indexOffset = 0;
+    std::uint32_t tileSize = static_cast<std::uint32_t>(options.tileSize);
+    std::uint32_t inBetweens = static_cast<std::uint32_t>(options.inBetweens);
+    append(FRAME_FILE_MAGIC, sizeof(FRAME_FILE_MAGIC));
+    append(&version, sizeof(version));
+    append(&bytesPerValue, sizeof(bytesPerValue));
+    append(&placeholderCount, sizeof(int));
+    append(&width, sizeof(int));
+    append(&height, sizeof(int));
+    append(&codec, sizeof(codec));
+    append(&keyframeInterval, sizeof(keyframeInterval));
+    append(&options.errorBound, sizeof(options.errorBound));
+    append(&indexOffset, sizeof(indexOffset));
+    append(&tileSize, sizeof(tileSize));
+    append(&inBetweens, sizeof(inBetweens));
+
+    ioThread = std::thread(&FrameWriter::ioLoop, this);
+    return true;
+}
+
+template <typename Real>
+void FrameWriter::writeFrame(const BasicVelocityField<Real>& frame, double time) {
+    std::size_t frameBytes = rowBuffer.size() * height;
+    FrameStatistics<Real> stats;
+    FrameIndexEntry entry;
+    entry.offset = appended + sizeof(std::uint64_t);
+    entry.time = time;
+
+    if (options.codec == FrameCodec::Raw && options.tileSize == 0) {
+        // rows stream straight into the buffers
+        std::uint64_t size = frameBytes;
+        append(&size, sizeof(size));
+        for (int i = 0; i < height; i++) {
+            if (precision == Precision::Float) {
+                interleaveRow<float>(rowBuffer.data(), frame.u.row(i), frame.v.row(i), width, stats);
+            }
+            else {
+                interleaveRow<double>(rowBuffer.data(), frame.u.row(i), frame.v.row(i), width, stats);
+            }
+            append(rowBuffer.data(), rowBuffer.size());
+        }
+        appendChunk(nullptr, frameBytes);
+        entry.payloadBytes = frameBytes;
+    }
+    else {
+        unsigned char* values = reinterpret_cast<unsigned char*>(frameBuffer.data());
+        std::size_t count = frameBytes / (precision == Precision::Float ? sizeof(float) : sizeof(double));
+        bool keyframe = frameCount % options.keyframeInterval == 0;
+        for (int i = 0; i < height; i++) {
+            if (precision == Precision::Float) {
+                interleaveRow<float>(values + i * rowBuffer.size(), frame.u.row(i), frame.v.row(i), width, stats);
+            }
+            else {
+                interleaveRow<double>(values + i * rowBuffer.size(), frame.u.row(i), frame.v.row(i), width, stats);
+            }
+        }
+        if (options.tileSize > 0 && precision == Precision::Float) {
+            encodeTiles(floatTileEncoders, reinterpret_cast<const float*>(values), keyframe);
+        }
+        else if (options.tileSize > 0) {
+            encodeTiles(doubleTileEncoders, reinterpret_cast<const double*>(values), keyframe);
+        }
+        else if (precision == Precision::Float) {
+            floatEncoder.encode(reinterpret_cast<const float*>(values), count, keyframe, encoded);
+        }
+        else {
+            doubleEncoder.encode(reinterpret_cast<const double*>(values), count, keyframe, encoded);
+        }
+        std::uint64_t size = encoded.size();
+        append(&size, sizeof(size));
+        appendChunk(encoded.data(), encoded.size());
+        entry.payloadBytes = encoded.size();
+    }
+    stats.store(entry);
+    index.push_back(entry);
+    frameCount++;
+}
+
+// Replaces encoded with the tiled payload of one interleaved frame: the tile offset table,
+// then every tile gathered into tileBuffer and coded by its own encoder
+template <typename Stored>
+void FrameWriter::encodeTiles(std::vector<FrameEncoder<Stored>>& encoders, const Stored* values, bool keyframe) {
+    int size = options.tileSize;
+    int tilesX = (width + size - 1) / size;
+    int tilesY = (height + size - 1) / size;
+    std::uint64_t offset = 0;
+    encoded.resize((static_cast<std::size_t>(tilesX) * tilesY + 1) * sizeof(offset));
+    std::memcpy(encoded.data(), &offset, sizeof(offset));
+
+    Stored* tile = reinterpret_cast<Stored*>(tileBuffer.data());
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            int rows = std::min(size, height - ty * size);
+            int cols = std::min(size, width - tx * size);
+            for (int r = 0; r < rows; r++) {
+                const Stored* source = values + (static_cast<std::size_t>(ty * size + r) * width + tx * size) * 2;
+                std::copy(source, source + 2 * cols, tile + static_cast<std::size_t>(r) * 2 * cols);
+            }
+            int t = ty * tilesX + tx;
+            encoders[t].encode(tile, static_cast<std::size_t>(rows) * cols * 2, keyframe, tileEncoded);
+            encoded.insert(encoded.end(), tileEncoded.begin(), tileEncoded.end());
+            offset += tileEncoded.size();
+            std::memcpy(encoded.data() + (t + 1) * sizeof(offset), &offset, sizeof(offset));
+        }
+    }
+}
+
+// Appends a frame's payload (nullptr when it was already appended) and pads it to 8 bytes
+void FrameWriter::appendChunk(const unsigned char* payload, std::size_t bytes) {
+    static const unsigned char zeros[8] = {};
+    if (payload) append(payload, bytes);
+    append(zeros, (8 - bytes % 8) % 8);
+    payloadBytes += bytes;
+}
+
+void FrameWriter::append(const void* data, std::size_t bytes) {
+    const unsigned char* source = static_cast<const unsigned char*>(data);
+    while (bytes > 0) {
+        Buffer& buffer = buffers[current];
+        std::size_t count = std::min(bytes, options.bufferBytes - buffer.used);
+        std::memcpy(buffer.data + buffer.used, source, count);
+        buffer.used += count;
+        appended += count;
+        source += count;
+        bytes -= count;
+        if (buffer.used == options.bufferBytes) {
+            queueCurrent();
+        }
+    }
+}
+
+void FrameWriter::queueCurrent() {
+    // every buffer but the current one fits in the queue, so this push cannot fail
+    fullBuffers.tryPush(current);
+    if (!freeBuffers.tryPop(current)) {
+        stallCount++;
+        stallSeconds += waitUntil([this] { return freeBuffers.tryPop(current); });
+    }
+    buffers[current].used = 0;
+}
+
+void FrameWriter::ioLoop() {
+    while (true) {
+        // close() queues its last buffer before setting finishing, so once finishing is
+        // seen, one more empty pop means everything has been written
+        int index;
+        bool finished = false;
+        ioCounters.addWait(waitUntil([&] {
+            if (fullBuffers.tryPop(index)) return true;
+            finished = finishing.load(std::memory_order_acquire) && !fullBuffers.tryPop(index);
+            return finished;
+        }));
+        if (finished) return;
+        ioCounters.sampleQueueDepth(fullBuffers.size() + 1);
+
+        Buffer& buffer = buffers[index];
+        auto start = std::chrono::steady_clock::now();
+        bool ok = writeAll(buffer.data, buffer.used);
+        if (ok && options.sync == SyncPolicy::EveryBuffer) {
+            ok = syncData(fd);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ioSeconds += seconds;
+        bytesWritten += buffer.used;
+        ioCounters.addBusy(seconds);
+        ioCounters.addItem();
+
+        if (!ok) failed = true;
+        freeBuffers.tryPush(index);
+    }
+}
+
+bool FrameWriter::writeAll(const unsigned char* data, std::size_t bytes) {
+    while (bytes > 0) {
+        long written = writeSome(fd, data, bytes);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        bytes -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+bool FrameWriter::close(bool quiet) {
+    if (!isOpen()) return false;
+
+    // frames end on an 8-byte boundary, so the index entries are aligned in the file
+    std::uint64_t indexOffset = appended;
+    std::uint32_t entries = static_cast<std::uint32_t>(index.size());
+    append(FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC));
+    append(&entries, sizeof(entries));
+    append(index.data(), index.size() * sizeof(FrameIndexEntry));
+
+    finishing.store(true, std::memory_order_release);
+    ioThread.join();
+
+    // the tail is shorter than a block, so it goes through the page cache
+    Buffer& tail = buffers[current];
+#if defined(O_DIRECT) && !defined(_WIN32)
+    if (directIO) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    }
+#endif
+    auto start = std::chrono::steady_clock::now();
+    bool ok = !failed && writeAll(tail.data, tail.used);
+    bytesWritten += tail.used;
+    ok = ok && writeAt(fd, sizeof(FRAME_FILE_MAGIC) + 2 * sizeof(std::uint32_t), &frameCount, sizeof(int));
+    ok = ok && writeAt(fd, FRAME_INDEX_OFFSET_POSITION, &indexOffset, sizeof(indexOffset));
+    if (ok && options.sync != SyncPolicy::None) {
+        ok = syncData(fd);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ioSeconds += seconds;
+    // the tail is the write stage's last buffer, written here rather than on the I/O thread
+    ioCounters.addBusy(seconds);
+    ioCounters.addItem();
+
+    closeFile(fd);
+    fd = -1;
+    release();
+
+    if (!ok) {
+        std::cerr << "Error: writing " << path << " failed" << std::endl;
+        return false;
+    }
+    if (!quiet) {
+        std::cout << "Successfully wrote " << frameCount << " " << precisionName(precision) << " frames to " << path
+                  << " (" << bytesWritten / 1e6 << " MB, " << sustainedMegabytesPerSecond() << " MB/s sustained, "
+                  << stallCount << " stalls)" << std::endl;
+        if (options.codec != FrameCodec::Raw && payloadBytes > 0) {
+            double rawBytes = double(frameCount) * rowBuffer.size() * height;
+            std::cout << "Codec: " << frameCodecName(options.codec);
+            if (options.codec == FrameCodec::Quantized) std::cout << " (error bound " << options.errorBound << ")";
+            std::cout << ", " << rawBytes / payloadBytes << "x smaller than raw" << std::endl;
+        }
+    }
+    return true;
+}
+
+double FrameWriter::sustainedMegabytesPerSecond() const {
+    return ioSeconds > 0 ? bytesWritten / 1e6 / ioSeconds : 0;
+}
+
+void FrameWriter::release() {
+    for (Buffer& buffer : buffers) {
+        std::free(buffer.data);
+    }
+    buffers.clear();
+    freeBuffers.reset(1);
+    fullBuffers.reset(1);
+    current = -1;
+}
+
+template void FrameWriter::writeFrame<float>(const BasicVelocityField<float>&, double);
+template void FrameWriter::writeFrame<double>(const BasicVelocityField<double>&, double);
@@ -0,0 +1,129 @@
+#ifndef FRAME_WRITER_HPP
+#define FRAME_WRITER_HPP
+
+#include "frame_io.hpp"
+#include "spsc_queue.hpp"
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+// When the background thread asks the OS to put written data on disk
+enum class SyncPolicy {
+    None,         // leave it to the page cache
+    AtClose,      // one fdatasync after the last buffer
+    EveryBuffer   // fdatasync after each buffer, so at most one buffer is ever at risk
+};
+
+// Writes a frame file (frame_io.hpp layout) from a background I/O thread. Frames are
+// serialized into large aligned buffers on the caller's thread; a full buffer is queued and
+// the caller continues in the next free one. It only waits when every buffer is still
+// queued, which means the disk is behind by the whole queue. Buffers travel to the I/O thread
+// and back through lock-free queues. Compressed codecs encode each
+// frame on the caller's thread before it is buffered. close() appends the frame index and
+// patches the frame count and index offset into the header.
+class FrameWriter {
+public:
+    struct Options {
+        std::size_t bufferBytes = std::size_t(8) << 20;   // rounded up to a multiple of 4096
+        int queueDepth = 4;                                // buffers that can be in flight
+        bool directIO = false;                             // O_DIRECT where supported: bypass the page cache
+        SyncPolicy sync = SyncPolicy::None;
+        FrameCodec codec = FrameCodec::Raw;
+        double errorBound = 1e-5;                          // quantized codec: largest error per value
+        int keyframeInterval = 32;                         // frames a seek may have to decode
+        int tileSize = 0;                                  // tile side for region reads; 0 keeps frames whole
+        int inBetweens = 0;                                // blends players compute between frames
+    };
+
+    FrameWriter() = default;
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // Creates filename for frames of width x height stored in precision and starts the I/O
+    // thread. Prints the problem and returns false if the file cannot be created.
+    bool open(const std::string& filename, int width, int height, Precision precision, const Options& options);
+    bool open(const std::string& filename, int width, int height, Precision precision) {
+        return open(filename, width, height, precision, Options());
+    }
+
+    // Appends one frame, converted to the file's precision, stamped with its simulated time
+    template <typename Real>
+    void writeFrame(const BasicVelocityField<Real>& frame, double time);
+
+    // Flushes the last buffer, waits for the I/O thread and finalizes the header. Returns
+    // false if any write failed. Prints the sustained rate and compression unless quiet.
+    bool close(bool quiet = false);
+
+    bool isOpen() const { return fd >= 0; }
+    int framesWritten() const { return frameCount; }
+
+    // Times the caller had to wait for a free buffer, and how long it waited in all
+    int stalls() const { return stallCount; }
+    double stalledSeconds() const { return stallSeconds; }
+
+    // Bytes written divided by the time the I/O thread spent inside write and sync calls
+    double sustainedMegabytesPerSecond() const;
+
+    // The I/O thread as a pipeline stage: buffers written, time in write calls and idle, and
+    // buffers queued for it. Safe to call while frames are being written.
+    StageStats ioStats() const { return ioCounters.stats("write"); }
+
+private:
+    struct Buffer {
+        unsigned char* data = nullptr;
+        std::size_t used = 0;
+    };
+
+    int fd = -1;
+    std::string path;
+    int width = 0;
+    int height = 0;
+    Precision precision = Precision::Double;
+    Options options;
+    bool directIO = false;
+
+    std::vector<Buffer> buffers;
+    SpscQueue<int> freeBuffers;       // from the I/O thread back to the caller
+    SpscQueue<int> fullBuffers;       // buffers waiting for the I/O thread, in order
+    int current = -1;                 // buffer being filled by the caller
+    std::vector<unsigned char> rowBuffer;    // one row interleaved in the file's precision
+    std::vector<double> frameBuffer;         // compressed codecs: the whole frame, as float or double
+    std::vector<unsigned char> encoded;
+    FrameEncoder<float> floatEncoder{FrameCodec::Raw, 0};
+    FrameEncoder<double> doubleEncoder{FrameCodec::Raw, 0};
+
+    // tiled files: one encoder per tile, each tile gathered and coded on its own
+    std::vector<FrameEncoder<float>> floatTileEncoders;
+    std::vector<FrameEncoder<double>> doubleTileEncoders;
+    std::vector<double> tileBuffer;
+    std::vector<unsigned char> tileEncoded;
+
+    std::thread ioThread;
+    std::atomic<bool> finishing{ false };
+    bool failed = false;              // set by the I/O thread, read after it is joined
+    StageCounters ioCounters;
+
+    int frameCount = 0;
+    int stallCount = 0;
+    double stallSeconds = 0;
+    std::size_t bytesWritten = 0;
+    std::size_t payloadBytes = 0;     // frame data as stored, without chunk sizes or padding
+    std::uint64_t appended = 0;       // file offset of the next byte appended
+    std::vector<FrameIndexEntry> index;
+    double ioSeconds = 0;
+
+    void append(const void* data, std::size_t bytes);
+    void appendChunk(const unsigned char* payload, std::size_t bytes);
+    template <typename Stored>
+    void encodeTiles(std::vector<FrameEncoder<Stored>>& encoders, const Stored* values, bool keyframe);
+    void queueCurrent();
+    void ioLoop();
+    bool writeAll(const unsigned char* data, std::size_t bytes);
+    void release();
+};
+
+#endif // FRAME_WRITER_HPP
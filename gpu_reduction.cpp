@@ -0,0 +1,161 @@
+#include "gpu_reduction.hpp"
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+// Shader op codes: the two sums, and min/max which also serves Max
+int shaderOp(GPUReduction::Op op) {
+    switch (op) {
+        case GPUReduction::Op::Sum: return 0;
+        case GPUReduction::Op::L2Norm: return 1;
+        default: return 2;
+    }
+}
+
+int groupsFor(int count) {
+    return (count + 255) / 256;
+}
+
+}
+
+bool GPUReduction::initialize(ShaderManager& shaderManager, int maxWidth, int maxHeight) {
+    fieldProgram = shaderManager.getProgram("reduction_field");
+    if (fieldProgram == 0) {
+        GLuint fieldShader = shaderManager.createComputeShader("reduction_field", ShaderManager::REDUCTION_FIELD_SHADER_SOURCE);
+        if (fieldShader == 0) return false;
+        fieldProgram = shaderManager.createComputeProgram("reduction_field", fieldShader);
+        if (fieldProgram == 0) return false;
+    }
+
+    partialsProgram = shaderManager.getProgram("reduction_partials");
+    if (partialsProgram == 0) {
+        GLuint partialsShader = shaderManager.createComputeShader("reduction_partials", ShaderManager::REDUCTION_PARTIALS_SHADER_SOURCE);
+        if (partialsShader == 0) return false;
+        partialsProgram = shaderManager.createComputeProgram("reduction_partials", partialsShader);
+        if (partialsProgram == 0) return false;
+    }
+
+    // One partial per 16x16 tile; every later pass leaves fewer
+    GLsizeiptr partialBytes = static_cast<GLsizeiptr>((maxWidth + 15) / 16) * ((maxHeight + 15) / 16) * 2 * sizeof(float);
+    glGenBuffers(2, partials);
+    for (GLuint buffer : partials) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, partialBytes, nullptr, GL_DYNAMIC_COPY);
+    }
+    for (Query& query : queries) {
+        glGenBuffers(1, &query.buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, query.buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(float), nullptr, GL_DYNAMIC_READ);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cerr << "Error creating reduction buffers: " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void GPUReduction::cleanup() {
+    for (Query& query : queries) {
+        if (query.fence) glDeleteSync(query.fence);
+        if (query.buffer) glDeleteBuffers(1, &query.buffer);
+        query = Query();
+    }
+    if (partials[0]) glDeleteBuffers(2, partials);
+    partials[0] = partials[1] = 0;
+    // the programs belong to the ShaderManager
+    fieldProgram = partialsProgram = 0;
+}
+
+std::uint64_t GPUReduction::reduce(GLuint texture, int width, int height, int components, Op op) {
+    Query& query = queries[nextTicket % RING_SIZE];
+    if (query.fence) glDeleteSync(query.fence);
+    query.ticket = nextTicket++;
+    query.op = op;
+
+    // The solver writes its fields through image stores
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    int groupsX = (width + 15) / 16;
+    int groupsY = (height + 15) / 16;
+    int count = groupsX * groupsY;
+    glUseProgram(fieldProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(glGetUniformLocation(fieldProgram, "field"), 0);
+    glUniform1i(glGetUniformLocation(fieldProgram, "width"), width);
+    glUniform1i(glGetUniformLocation(fieldProgram, "height"), height);
+    glUniform1i(glGetUniformLocation(fieldProgram, "components"), components);
+    glUniform1i(glGetUniformLocation(fieldProgram, "op"), shaderOp(op));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, count == 1 ? query.buffer : partials[0]);
+    glDispatchCompute(groupsX, groupsY, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Each further pass leaves one partial per 256; the last one writes the result
+    glUseProgram(partialsProgram);
+    glUniform1i(glGetUniformLocation(partialsProgram, "op"), shaderOp(op));
+    int source = 0;
+    while (count > 1) {
+        int groups = groupsFor(count);
+        glUniform1i(glGetUniformLocation(partialsProgram, "count"), count);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, partials[source]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, groups == 1 ? query.buffer : partials[1 - source]);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        source = 1 - source;
+        count = groups;
+    }
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    query.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    return query.ticket;
+}
+
+bool GPUReduction::read(Query& query, Result& result) {
+    float values[2];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, query.buffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(values), values);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glDeleteSync(query.fence);
+    query.fence = nullptr;
+
+    result = Result();
+    switch (query.op) {
+        case Op::Sum: result.value = values[0]; break;
+        case Op::L2Norm: result.value = std::sqrt(values[0]); break;
+        default:
+            result.min = values[0];
+            result.max = values[1];
+            result.value = values[1];
+            break;
+    }
+    return true;
+}
+
+GLuint GPUReduction::resultBuffer(std::uint64_t ticket) const {
+    const Query& query = queries[ticket % RING_SIZE];
+    return query.ticket == ticket ? query.buffer : 0;
+}
+
+bool GPUReduction::poll(std::uint64_t ticket, Result& result) {
+    Query& query = queries[ticket % RING_SIZE];
+    if (query.ticket != ticket || !query.fence) return false;
+    GLenum status = glClientWaitSync(query.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+    return read(query, result);
+}
+
+bool GPUReduction::wait(std::uint64_t ticket, Result& result) {
+    Query& query = queries[ticket % RING_SIZE];
+    if (query.ticket != ticket || !query.fence) return false;
+    while (true) {
+        GLenum status = glClientWaitSync(query.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) break;
+        if (status == GL_WAIT_FAILED) return false;
+    }
+    return read(query, result);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "shader_manager.hpp"
+
+// Statistics of a field texture reduced on the GPU: max, sum, L2 norm or min and max over
+// every cell. A cell's value is its first channel, or for two-channel (velocity) textures the
+// length of its vector. Each pass reduces 256 values per work group in shared memory and the
+// passes form a tree down to one result, so sums come out the same on every run.
+//
+// Results are read back asynchronously: reduce() queues the passes and fences the result,
+// and poll() collects it without waiting once the GPU is done. Results live in a small ring
+// of buffers, so a caller can keep several in flight; a ticket is lost once the ring has come
+// round to its buffer again. Shaders can also read a result where it lands, with no readback.
+// Several instances may share one ShaderManager; they share its programs.
+class GPUReduction {
+public:
+    enum class Op {
+        Max,
+        Sum,
+        L2Norm,     // square root of the sum of squares
+        MinMax
+    };
+
+    struct Result {
+        float value = 0;    // the max, sum or norm; for MinMax, the max
+        float min = 0;      // Max and MinMax only
+        float max = 0;
+    };
+
+    static constexpr int RING_SIZE = 8;
+
+    GPUReduction() = default;
+    ~GPUReduction() { cleanup(); }
+
+    GPUReduction(const GPUReduction&) = delete;
+    GPUReduction& operator=(const GPUReduction&) = delete;
+
+    // Builds the programs, or takes them from shaderManager when another instance already
+    // has, and sizes the partials for fields of up to maxWidth x maxHeight
+    bool initialize(ShaderManager& shaderManager, int maxWidth, int maxHeight);
+    void cleanup();
+
+    // Queues a reduction of texture (width x height, components 1 or 2) and returns its ticket
+    std::uint64_t reduce(GLuint texture, int width, int height, int components, Op op);
+
+    // Fills result once the reduction has finished; never waits. False while it is still
+    // running, for a ticket already read, and for one whose buffer has since been reused.
+    bool poll(std::uint64_t ticket, Result& result);
+
+    // Waits for the reduction; false for a ticket already read or whose buffer has been reused
+    bool wait(std::uint64_t ticket, Result& result);
+
+    // The buffer the result lands in, for shaders that use it on the GPU: two floats, (min, max)
+    // for Max and MinMax, or (sum, 0) for Sum and the sum of squares for L2Norm. 0 once the
+    // ring has come round to it.
+    GLuint resultBuffer(std::uint64_t ticket) const;
+
+private:
+    struct Query {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        std::uint64_t ticket = 0;
+        Op op = Op::Max;
+    };
+
+    GLuint fieldProgram = 0;
+    GLuint partialsProgram = 0;
+    GLuint partials[2] = { 0, 0 };
+    Query queries[RING_SIZE];
+    std::uint64_t nextTicket = 1;
+
+    bool read(Query& query, Result& result);
+};
@@ -4,6 +4,8 @@
 #include <iomanip>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
 void GPUSolver::checkGLError(const char* context) {
     GLenum err;
@@ -20,9 +22,9 @@ void GPUSolver::checkGLError(const char* context) {
     }
 }
 
-GPUSolver::GPUSolver(int width, int height)
-    : window(nullptr), windowWidth(800), windowHeight(600),
-      gridWidth(width), gridHeight(height), currentBuffer(0) {
+GPUSolver::GPUSolver(const SimulationConfig& config)
+    : window(nullptr), windowWidth(800), windowHeight(600), headless(false),
+      gridWidth(config.width), gridHeight(config.height), currentBuffer(0) {
 
     velocityTexture[0] = velocityTexture[1] = velocityBefore = 0;
     pressureTexture[0] = pressureTexture[1] = divergenceTexture = 0;
@@ -33,12 +35,37 @@ GPUSolver::GPUSolver(int width, int height)
     advectionProgram = diffusionProgram = projectionProgram = 0;
     projectionGradientProgram = boundaryProgram = forceProgram = 0;
 
-    displayVAO = displayVBO = displayTexture = 0;
+    displayVAO = displayVBO = colormapTexture = 0;
     displayShaderProgram = 0;
 
-    timeStep = 0.2f;
-    viscosity = 30.0f;
-    alpha = viscosity * timeStep / (1.0f * 1.0f);
+    multigridResidualShader = multigridRestrictShader = multigridProlongShader = 0;
+    multigridResidualProgram = multigridRestrictProgram = multigridProlongProgram = 0;
+    pressureSolver = config.pressureSolver;
+    multigridCycle = config.multigridCycle;
+    multigridCycles = config.multigridCycles;
+
+    pendingResidual = 0;
+    pendingResidualScale = 1;
+    splatBuffer = 0;
+    splatBufferCapacity = 0;
+    diffusionIterations = config.diffusionIterations;
+    pressureIterations = config.projectionIterations;
+    diffusionTolerance = static_cast<float>(config.diffusionTolerance);
+    pressureTolerance = static_cast<float>(config.projectionTolerance);
+    residualCheckInterval = config.residualCheckInterval;
+
+    stepCount = 0;
+    simulationTime = 0;
+    checkpointConfig = config;
+    checkpointConfig.precision = Precision::Float;
+    checkpointBuffer = 0;
+    checkpointFence = nullptr;
+    checkpointStep = 0;
+    checkpointTime = 0;
+
+    timeStep = static_cast<float>(config.timeStep);
+    viscosity = static_cast<float>(config.viscosity);
+    alpha = static_cast<float>(config.viscosity * config.timeStep / (config.dx * config.dx));
 }
 
 GPUSolver::~GPUSolver() {
@@ -87,8 +114,25 @@ bool GPUSolver::initializeShaders() {
     projectionGradientProgram = shaderManager.createComputeProgram("projection_gradient", projectionGradientShader);
     if (projectionGradientProgram == 0) return false;
 
+    // Multigrid Shaders
+    std::cout << "\nCreating Multigrid shaders..." << std::endl;
+    multigridResidualShader = shaderManager.createComputeShader("multigrid_residual", ShaderManager::MULTIGRID_RESIDUAL_SHADER_SOURCE);
+    if (multigridResidualShader == 0) return false;
+    multigridResidualProgram = shaderManager.createComputeProgram("multigrid_residual", multigridResidualShader);
+    if (multigridResidualProgram == 0) return false;
+
+    multigridRestrictShader = shaderManager.createComputeShader("multigrid_restrict", ShaderManager::MULTIGRID_RESTRICT_SHADER_SOURCE);
+    if (multigridRestrictShader == 0) return false;
+    multigridRestrictProgram = shaderManager.createComputeProgram("multigrid_restrict", multigridRestrictShader);
+    if (multigridRestrictProgram == 0) return false;
+
+    multigridProlongShader = shaderManager.createComputeShader("multigrid_prolong", ShaderManager::MULTIGRID_PROLONG_SHADER_SOURCE);
+    if (multigridProlongShader == 0) return false;
+    multigridProlongProgram = shaderManager.createComputeProgram("multigrid_prolong", multigridProlongShader);
+    if (multigridProlongProgram == 0) return false;
+
     // Create display shader for rendering
-    if (!initializeDisplayShader()) {
+    if (!headless && !initializeDisplayShader()) {
         std::cerr << "Failed to initialize display shader" << std::endl;
         return false;
     }
@@ -130,13 +174,29 @@ bool GPUSolver::initializeDisplayShader() {
         }
     )";
 
+    // Each pixel shows the grid cell it covers, grid row 0 at the top of the window; the
+    // colormap is sampled at texel centres
     const char* fragmentShaderSource = R"(
         #version 430 core
         in vec2 TexCoord;
         out vec4 FragColor;
-        uniform sampler2D displayTexture;
+        uniform sampler2D velocityField;
+        uniform sampler1D colormap;
+        uniform ivec2 displaySize;
+        // the speed range (min, max) as GPUReduction leaves it
+        layout(std430, binding = 0) readonly buffer DisplayScale {
+            vec2 speedRange;
+        };
         void main() {
-            FragColor = texture(displayTexture, TexCoord);
+            ivec2 size = textureSize(velocityField, 0);
+            ivec2 pixel = ivec2(gl_FragCoord.xy);
+            ivec2 cell = ivec2(pixel.x * size.x / displaySize.x, (displaySize.y - 1 - pixel.y) * size.y / displaySize.y);
+            float magnitude = length(texelFetch(velocityField, cell, 0).xy);
+            // even very small velocities get some normalization
+            float maxVelocity = max(speedRange.y, 0.01);
+            float normalized = sqrt(min(magnitude / (maxVelocity * 0.3), 1.0));
+            int entries = textureSize(colormap, 0);
+            FragColor = vec4(texture(colormap, (normalized * (entries - 1) + 0.5) / entries).rgb, 1.0);
         }
     )";
 
@@ -212,14 +272,34 @@ bool GPUSolver::initializeDisplayShader() {
 
     glBindVertexArray(0);
 
-    // Create display texture
-    glGenTextures(1, &displayTexture);
-    glBindTexture(GL_TEXTURE_2D, displayTexture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, windowWidth, windowHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    // Colormap lookup texture: heat map from blue through cyan, green and yellow to red
+    const int colormapEntries = 256;
+    std::vector<unsigned char> colormap(colormapEntries * 3);
+    for (int i = 0; i < colormapEntries; i++) {
+        float normalized = static_cast<float>(i) / (colormapEntries - 1);
+        float r, g, b;
+        if (normalized < 0.25f) {
+            r = 0; g = normalized / 0.25f; b = 1;
+        } else if (normalized < 0.5f) {
+            r = 0; g = 1; b = 1 - (normalized - 0.25f) / 0.25f;
+        } else if (normalized < 0.75f) {
+            r = (normalized - 0.5f) / 0.25f; g = 1; b = 0;
+        } else {
+            r = 1; g = 1 - (normalized - 0.75f) / 0.25f; b = 0;
+        }
+        colormap[i * 3] = static_cast<unsigned char>(r * 255);
+        colormap[i * 3 + 1] = static_cast<unsigned char>(g * 255);
+        colormap[i * 3 + 2] = static_cast<unsigned char>(b * 255);
+    }
+    glGenTextures(1, &colormapTexture);
+    glBindTexture(GL_TEXTURE_1D, colormapTexture);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, colormapEntries, 0, GL_RGB, GL_UNSIGNED_BYTE, colormap.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_1D, 0);
 
     std::cout << "Display shader initialized successfully" << std::endl;
     return true;
@@ -246,15 +326,51 @@ bool GPUSolver::initializeTextures() {
     divergenceTexture = createTexture(gridWidth, gridHeight, GL_R32F);
     if (!divergenceTexture) return false;
 
+    if (!initializeMultigrid()) return false;
+
     std::cout << "All textures initialized successfully" << std::endl;
     return true;
 }
 
-bool GPUSolver::initialize() {
-    std::cout << "\nInitializing GPU solver..." << std::endl;
+bool GPUSolver::initializeMultigrid() {
+    MultigridLevel fine;
+    fine.width = gridWidth;
+    fine.height = gridHeight;
+    fine.pressure[0] = pressureTexture[0];
+    fine.pressure[1] = pressureTexture[1];
+    fine.rhs = divergenceTexture;
+    fine.residual = createTexture(gridWidth, gridHeight, GL_R32F);
+    multigridLevels.push_back(fine);
+    if (!fine.residual) return false;
+
+    int w = gridWidth, h = gridHeight;
+    while (std::min(w, h) > 4) {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+
+        MultigridLevel coarse;
+        coarse.width = w;
+        coarse.height = h;
+        coarse.pressure[0] = createTexture(w, h, GL_R32F);
+        coarse.pressure[1] = createTexture(w, h, GL_R32F);
+        coarse.rhs = createTexture(w, h, GL_R32F);
+        coarse.residual = createTexture(w, h, GL_R32F);
+        multigridLevels.push_back(coarse);
+        if (!coarse.pressure[0] || !coarse.pressure[1] || !coarse.rhs || !coarse.residual) return false;
+    }
 
+    std::cout << "Multigrid levels: " << multigridLevels.size() << std::endl;
+    return true;
+}
+
+// Creates the context window: a visible one, or for headless runs one that is never shown
+bool GPUSolver::createWindow(bool useNullPlatform) {
+#ifdef GLFW_PLATFORM_NULL
+    glfwInitHint(GLFW_PLATFORM, useNullPlatform ? GLFW_PLATFORM_NULL : GLFW_ANY_PLATFORM);
+#else
+    if (useNullPlatform) return false;
+#endif
     if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
         return false;
     }
 
@@ -262,20 +378,43 @@ bool GPUSolver::initialize() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_VISIBLE, headless ? GLFW_FALSE : GLFW_TRUE);
+    // the null platform has no native context API; EGL gives it a surfaceless one
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, useNullPlatform ? GLFW_EGL_CONTEXT_API : GLFW_NATIVE_CONTEXT_API);
 
     window = glfwCreateWindow(windowWidth, windowHeight, "Navier-Stokes GPU Solver", nullptr, nullptr);
     if (!window) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return false;
     }
+    return true;
+}
+
+bool GPUSolver::initialize(bool headlessMode) {
+    std::cout << "\nInitializing GPU solver..." << std::endl;
+    headless = headlessMode;
+
+    // Headless runs first try a context without any display server (EGL surfaceless, which
+    // Mesa's llvmpipe provides), then a hidden window on the default platform
+    bool nullPlatform = headless && createWindow(true);
+    if (!nullPlatform && !createWindow(false)) {
+        std::cerr << "Failed to create GLFW window" << (headless ? " (headless: no EGL surfaceless context either)" : "")
+                  << std::endl;
+        return false;
+    }
+    if (headless) {
+        std::cout << "Headless context: " << (nullPlatform ? "EGL surfaceless" : "hidden window") << std::endl;
+    }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    // vsync would tie the step rate to the display; headless runs never present
+    glfwSwapInterval(headless ? 0 : 1);
 
     glewExperimental = GL_TRUE;
     GLenum err = glewInit();
-    if (err != GLEW_OK) {
+    // GLEW looks for a GLX display after loading the GL entry points, which an EGL context
+    // does not have; the entry points are loaded all the same
+    if (err != GLEW_OK && !(nullPlatform && err == GLEW_ERROR_NO_GLX_DISPLAY)) {
         std::cerr << "Failed to initialize GLEW: " << glewGetErrorString(err) << std::endl;
         return false;
     }
@@ -303,7 +442,15 @@ bool GPUSolver::initialize() {
         return false;
     }
 
-    glViewport(0, 0, windowWidth, windowHeight);
+    if (!reduction.initialize(shaderManager, gridWidth, gridHeight) ||
+        !solverReduction.initialize(shaderManager, gridWidth, gridHeight)) {
+        cleanup();
+        return false;
+    }
+
+    if (!headless) {
+        glViewport(0, 0, windowWidth, windowHeight);
+    }
 
     std::cout << "\nGPU Solver initialized successfully!" << std::endl;
     std::cout << "Grid size: " << gridWidth << "x" << gridHeight << std::endl;
@@ -347,7 +494,28 @@ void GPUSolver::cleanup() {
     if (pressureTexture[0]) glDeleteTextures(1, &pressureTexture[0]);
     if (pressureTexture[1]) glDeleteTextures(1, &pressureTexture[1]);
     if (divergenceTexture) glDeleteTextures(1, &divergenceTexture);
-    if (displayTexture) glDeleteTextures(1, &displayTexture);
+    for (size_t l = 0; l < multigridLevels.size(); l++) {
+        MultigridLevel& level = multigridLevels[l];
+        if (l > 0) {
+            if (level.pressure[0]) glDeleteTextures(1, &level.pressure[0]);
+            if (level.pressure[1]) glDeleteTextures(1, &level.pressure[1]);
+            if (level.rhs) glDeleteTextures(1, &level.rhs);
+        }
+        if (level.residual) glDeleteTextures(1, &level.residual);
+    }
+    multigridLevels.clear();
+    resetResidualQueries();
+    reduction.cleanup();
+    solverReduction.cleanup();
+    if (splatBuffer) glDeleteBuffers(1, &splatBuffer);
+    splatBuffer = 0;
+    splatBufferCapacity = 0;
+    pendingSplats.clear();
+    if (checkpointFence) glDeleteSync(checkpointFence);
+    checkpointFence = nullptr;
+    if (checkpointBuffer) glDeleteBuffers(1, &checkpointBuffer);
+    checkpointBuffer = 0;
+    if (colormapTexture) glDeleteTextures(1, &colormapTexture);
 
     if (displayVAO) glDeleteVertexArrays(1, &displayVAO);
     if (displayVBO) glDeleteBuffers(1, &displayVBO);
@@ -365,6 +533,12 @@ void GPUSolver::cleanup() {
     if (projectionGradientProgram) glDeleteProgram(projectionGradientProgram);
     if (boundaryProgram) glDeleteProgram(boundaryProgram);
     if (forceProgram) glDeleteProgram(forceProgram);
+    if (multigridResidualShader) glDeleteShader(multigridResidualShader);
+    if (multigridRestrictShader) glDeleteShader(multigridRestrictShader);
+    if (multigridProlongShader) glDeleteShader(multigridProlongShader);
+    if (multigridResidualProgram) glDeleteProgram(multigridResidualProgram);
+    if (multigridRestrictProgram) glDeleteProgram(multigridRestrictProgram);
+    if (multigridProlongProgram) glDeleteProgram(multigridProlongProgram);
     if (displayShaderProgram) glDeleteProgram(displayShaderProgram);
 
     if (window) {
@@ -374,26 +548,62 @@ void GPUSolver::cleanup() {
     glfwTerminate();
 }
 
+void GPUSolver::finish() {
+    glFinish();
+}
+
 void GPUSolver::swapBuffers() {
     currentBuffer = 1 - currentBuffer;
 }
 
 void GPUSolver::applyForces() {
+    if (pendingSplats.empty()) return;
+
+    // Only the cells some splat can reach are dispatched
+    int minX = gridWidth, minY = gridHeight, maxX = -1, maxY = -1;
+    for (const ForceSplat& splat : pendingSplats) {
+        minX = std::min(minX, static_cast<int>(std::floor(splat.x - splat.radius)));
+        minY = std::min(minY, static_cast<int>(std::floor(splat.y - splat.radius)));
+        maxX = std::max(maxX, static_cast<int>(std::ceil(splat.x + splat.radius)));
+        maxY = std::max(maxY, static_cast<int>(std::ceil(splat.y + splat.radius)));
+    }
+    minX = std::max(minX, 0);
+    minY = std::max(minY, 0);
+    maxX = std::min(maxX, gridWidth - 1);
+    maxY = std::min(maxY, gridHeight - 1);
+    if (minX > maxX || minY > maxY) {
+        pendingSplats.clear();
+        return;
+    }
+
+    std::size_t bytes = pendingSplats.size() * sizeof(ForceSplat);
+    if (!splatBuffer) glGenBuffers(1, &splatBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, splatBuffer);
+    if (bytes > splatBufferCapacity) {
+        splatBufferCapacity = std::max(bytes, 2 * splatBufferCapacity);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, splatBufferCapacity, nullptr, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, pendingSplats.data());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, splatBuffer);
+    checkGLError("Force: upload splats");
+
     glUseProgram(forceProgram);
     checkGLError("Force: glUseProgram");
 
     glBindImageTexture(0, velocityTexture[currentBuffer], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
     checkGLError("Force: bind texture");
 
-    glUniform1f(glGetUniformLocation(forceProgram, "timeStep"), timeStep);
     glUniform1i(glGetUniformLocation(forceProgram, "width"), gridWidth);
     glUniform1i(glGetUniformLocation(forceProgram, "height"), gridHeight);
+    glUniform2i(glGetUniformLocation(forceProgram, "origin"), minX, minY);
+    glUniform1i(glGetUniformLocation(forceProgram, "splatCount"), static_cast<int>(pendingSplats.size()));
     checkGLError("Force: set uniforms");
 
-    glDispatchCompute((gridWidth + 15) / 16, (gridHeight + 15) / 16, 1);
+    glDispatchCompute((maxX - minX + 16) / 16, (maxY - minY + 16) / 16, 1);
     checkGLError("Force: dispatch");
 
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    pendingSplats.clear();
 }
 
 void GPUSolver::diffuse() {
@@ -402,18 +612,27 @@ void GPUSolver::diffuse() {
                       gridWidth, gridHeight, 1);
     checkGLError("Diffusion: copy texture");
 
-    for (int iter = 0; iter < 15; iter++) {
+    lastDiffusionSolve = { diffusionIterations, -1 };
+    resetResidualQueries();
+
+    // the per-cell change of a checked iteration goes to the level 0 residual texture, which
+    // the pressure solve only uses after diffusion
+    GLuint change = multigridLevels[0].residual;
+    for (int iter = 0; iter < diffusionIterations; iter++) {
+        bool check = diffusionTolerance > 0 && (iter + 1) % residualCheckInterval == 0 && iter + 1 < diffusionIterations;
         glUseProgram(diffusionProgram);
         checkGLError("Diffusion: use program");
 
         glBindImageTexture(0, velocityTexture[1-currentBuffer], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
         glBindImageTexture(1, velocityTexture[currentBuffer], 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
         glBindImageTexture(2, velocityBefore, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG32F);
+        glBindImageTexture(3, change, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
         checkGLError("Diffusion: bind textures");
 
         glUniform1f(glGetUniformLocation(diffusionProgram, "alpha"), alpha);
         glUniform1i(glGetUniformLocation(diffusionProgram, "width"), gridWidth);
         glUniform1i(glGetUniformLocation(diffusionProgram, "height"), gridHeight);
+        glUniform1i(glGetUniformLocation(diffusionProgram, "writeChange"), check ? 1 : 0);
         checkGLError("Diffusion: set uniforms");
 
         glDispatchCompute((gridWidth + 15) / 16, (gridHeight + 15) / 16, 1);
@@ -421,7 +640,23 @@ void GPUSolver::diffuse() {
 
         glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
         swapBuffers();
+
+        if (check) {
+            // The previous check covers the field as it was one interval ago; stopping now keeps
+            // the sweeps done since, which only lower the residual further
+            float residual;
+            if (readPreviousResidual(residual)) {
+                lastDiffusionSolve.residual = residual;
+                if (residual < diffusionTolerance) {
+                    lastDiffusionSolve.iterations = iter + 1;
+                    break;
+                }
+            }
+            // A Jacobi update is the residual of the previous iterate divided by the diagonal
+            issueResidualReduction(change, 1.0f + 4.0f * alpha);
+        }
     }
+    checkGLError("Diffusion: residual check");
 }
 
 void GPUSolver::advect() {
@@ -465,36 +700,46 @@ void GPUSolver::project() {
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
     checkGLError("Projection: divergence");
 
-    // Step 2: Pressure solve (Red-Black Gauss-Seidel)
-    int pressureBuffer = 0;
-    for (int iter = 0; iter < 20; iter++) {
-        // Red phase
-        glUniform1i(glGetUniformLocation(projectionProgram, "mode"), 1);
-        glBindImageTexture(1, pressureTexture[1-pressureBuffer], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-        glBindImageTexture(2, pressureTexture[pressureBuffer], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-
-        glDispatchCompute((gridWidth + 15) / 16, (gridHeight + 15) / 16, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-        pressureBuffer = 1 - pressureBuffer;
-
-        // Black phase
-        glUniform1i(glGetUniformLocation(projectionProgram, "mode"), 2);
-        glBindImageTexture(1, pressureTexture[1-pressureBuffer], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
-        glBindImageTexture(2, pressureTexture[pressureBuffer], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
-
-        glDispatchCompute((gridWidth + 15) / 16, (gridHeight + 15) / 16, 1);
-        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-
-        pressureBuffer = 1 - pressureBuffer;
+    // Step 2: Pressure solve (Red-Black Gauss-Seidel or multigrid).
+    // A full red+black sweep leaves the pressure back in pressureTexture[0].
+    if (pressureSolver == PressureSolver::Multigrid) {
+        for (int cycle = 0; cycle < multigridCycles; cycle++) {
+            runMultigridCycle(0);
+        }
+        lastPressureSolve = { multigridCycles, -1 };
+    } else {
+        const MultigridLevel& fine = multigridLevels[0];
+        lastPressureSolve = { pressureIterations, -1 };
+        resetResidualQueries();
+
+        int sweeps = 0;
+        while (sweeps < pressureIterations) {
+            int chunk = pressureIterations - sweeps;
+            if (pressureTolerance > 0) chunk = std::min(chunk, residualCheckInterval);
+            smoothPressure(fine, chunk);
+            sweeps += chunk;
+            if (pressureTolerance <= 0 || sweeps == pressureIterations) break;
+
+            float residual;
+            if (readPreviousResidual(residual)) {
+                lastPressureSolve.residual = residual;
+                if (residual < pressureTolerance) {
+                    lastPressureSolve.iterations = sweeps;
+                    break;
+                }
+            }
+            computePressureResidual(fine);
+            issueResidualReduction(fine.residual, 1.0f);
+        }
     }
+    checkGLError("Projection: pressure solve");
 
     // Step 3: Subtract pressure gradient
     glUseProgram(projectionGradientProgram);
     checkGLError("Projection: gradient program");
 
     glBindImageTexture(0, velocityTexture[currentBuffer], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RG32F);
-    glBindImageTexture(1, pressureTexture[pressureBuffer], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, pressureTexture[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
     checkGLError("Projection: gradient bind");
 
     glUniform1i(glGetUniformLocation(projectionGradientProgram, "width"), gridWidth);
@@ -506,90 +751,271 @@ void GPUSolver::project() {
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
     checkGLError("Projection: gradient");
 }
-void GPUSolver::render() {
-    // Download velocity data from GPU
-    std::vector<float> data(gridWidth * gridHeight * 2);
+void GPUSolver::step() {
+    applyForces();
+    diffuse();
+    advect();
+    project();
+    stepCount++;
+    simulationTime += timeStep;
+}
+
+std::uint64_t GPUSolver::reduceField(Field field, GPUReduction::Op op) {
+    switch (field) {
+        case Field::Velocity:
+            return reduction.reduce(velocityTexture[currentBuffer], gridWidth, gridHeight, 2, op);
+        case Field::Pressure:
+            // a full red+black sweep, and the multigrid cycle, leave the pressure in buffer 0
+            return reduction.reduce(pressureTexture[0], gridWidth, gridHeight, 1, op);
+        default:
+            return reduction.reduce(divergenceTexture, gridWidth, gridHeight, 1, op);
+    }
+}
+
+bool GPUSolver::requestCheckpoint() {
+    if (checkpointFence) return false;
+
+    GLsizeiptr velocityBytes = static_cast<GLsizeiptr>(gridWidth) * gridHeight * 2 * sizeof(float);
+    GLsizeiptr pressureBytes = static_cast<GLsizeiptr>(gridWidth) * gridHeight * sizeof(float);
+    if (!checkpointBuffer) {
+        glGenBuffers(1, &checkpointBuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, checkpointBuffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, velocityBytes + pressureBytes, nullptr, GL_STREAM_READ);
+    }
+
+    // with a pack buffer bound, glGetTexImage queues a copy on the GPU instead of waiting for it
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, checkpointBuffer);
     glBindTexture(GL_TEXTURE_2D, velocityTexture[currentBuffer]);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, data.data());
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, pressureTexture[0]);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, reinterpret_cast<void*>(velocityBytes));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    checkpointFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    checkGLError("requestCheckpoint");
+
+    checkpointStep = stepCount;
+    checkpointTime = simulationTime;
+    return true;
+}
 
-    // Create visualization with enhanced colors
-    std::vector<unsigned char> pixels(windowWidth * windowHeight * 3);
-
-    // Find max velocity for normalization
-    float maxVel = 0.0f;
-    for (int i = 0; i < gridWidth * gridHeight * 2; i += 2) {
-        float vx = data[i];
-        float vy = data[i + 1];
-        float mag = sqrt(vx*vx + vy*vy);
-        maxVel = std::max(maxVel, mag);
-    }
-
-    // Ensure we have some normalization even for very small velocities
-    if (maxVel < 0.01f) maxVel = 0.01f;
-
-    for (int y = 0; y < windowHeight; y++) {
-        for (int x = 0; x < windowWidth; x++) {
-            int gx = (x * gridWidth) / windowWidth;
-            int gy = (y * gridHeight) / windowHeight;
-
-            // FIX: Access data correctly - texture data is stored row by row
-            // The grid coordinate should map to the correct position in the 1D array
-            float vx = data[(gy * gridWidth + gx) * 2];
-            float vy = data[(gy * gridWidth + gx) * 2 + 1];
-            float mag = sqrt(vx*vx + vy*vy);
-
-            // Normalize and enhance visibility
-            float normalized = std::min(mag / (maxVel * 0.3f), 1.0f);
-
-            // Apply gamma correction for better visibility
-            normalized = pow(normalized, 0.5f);
-
-            // Create colorful visualization based on velocity direction and magnitude
-            // FIX: Flip vertically - OpenGL textures start from bottom-left,
-            // but we're rendering from top-left
-            int flippedY = windowHeight - 1 - y;
-            int idx = (flippedY * windowWidth + x) * 3;
-
-            // Option 1: Heatmap (blue -> cyan -> green -> yellow -> red)
-            if (normalized < 0.25f) {
-                // Blue to Cyan
-                float t = normalized / 0.25f;
-                pixels[idx] = 0;
-                pixels[idx+1] = static_cast<unsigned char>(t * 255);
-                pixels[idx+2] = 255;
-            } else if (normalized < 0.5f) {
-                // Cyan to Green
-                float t = (normalized - 0.25f) / 0.25f;
-                pixels[idx] = 0;
-                pixels[idx+1] = 255;
-                pixels[idx+2] = static_cast<unsigned char>((1.0f - t) * 255);
-            } else if (normalized < 0.75f) {
-                // Green to Yellow
-                float t = (normalized - 0.5f) / 0.25f;
-                pixels[idx] = static_cast<unsigned char>(t * 255);
-                pixels[idx+1] = 255;
-                pixels[idx+2] = 0;
-            } else {
-                // Yellow to Red
-                float t = (normalized - 0.75f) / 0.25f;
-                pixels[idx] = 255;
-                pixels[idx+1] = static_cast<unsigned char>((1.0f - t) * 255);
-                pixels[idx+2] = 0;
-            }
+bool GPUSolver::pollCheckpoint(SolverState<float>& state) {
+    if (!checkpointFence) return false;
+
+    GLenum status = glClientWaitSync(checkpointFence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(checkpointFence);
+    checkpointFence = nullptr;
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        std::cerr << "Checkpoint readback failed" << std::endl;
+        return false;
+    }
+
+    std::size_t cells = static_cast<std::size_t>(gridWidth) * gridHeight;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, checkpointBuffer);
+    const float* data = static_cast<const float*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 3 * cells * sizeof(float), GL_MAP_READ_BIT));
+    if (!data) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        checkGLError("pollCheckpoint: map");
+        return false;
+    }
+
+    state.config = checkpointConfig;
+    state.step = checkpointStep;
+    state.time = checkpointTime;
+    state.resize();
+    const float* pressure = data + 2 * cells;
+    for (int y = 0; y < gridHeight; y++) {
+        float* u = state.velocity.u.row(y);
+        float* v = state.velocity.v.row(y);
+        for (int x = 0; x < gridWidth; x++) {
+            std::size_t idx = (static_cast<std::size_t>(y) * gridWidth + x) * 2;
+            u[x] = data[idx];
+            v[x] = data[idx + 1];
+        }
+        std::memcpy(state.pressure.row(y), pressure + static_cast<std::size_t>(y) * gridWidth, gridWidth * sizeof(float));
+    }
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    checkGLError("pollCheckpoint");
+    return true;
+}
+
+bool GPUSolver::restoreCheckpoint(const SolverState<float>& state) {
+    if (state.velocity.rows() != gridHeight || state.velocity.cols() != gridWidth) {
+        std::cerr << "Checkpoint is " << state.velocity.cols() << "x" << state.velocity.rows()
+                  << " but the GPU grid is " << gridWidth << "x" << gridHeight << std::endl;
+        return false;
+    }
+
+    std::vector<float> data(static_cast<std::size_t>(gridWidth) * gridHeight * 2);
+    for (int y = 0; y < gridHeight; y++) {
+        const float* u = state.velocity.u.row(y);
+        const float* v = state.velocity.v.row(y);
+        for (int x = 0; x < gridWidth; x++) {
+            std::size_t idx = (static_cast<std::size_t>(y) * gridWidth + x) * 2;
+            data[idx] = u[x];
+            data[idx + 1] = v[x];
         }
     }
+    glBindTexture(GL_TEXTURE_2D, velocityTexture[currentBuffer]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridWidth, gridHeight, GL_RG, GL_FLOAT, data.data());
+
+    // pressure rows are copied one by one, as the state's rows need not be contiguous
+    glBindTexture(GL_TEXTURE_2D, pressureTexture[0]);
+    for (int y = 0; y < gridHeight; y++) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, gridWidth, 1, GL_RED, GL_FLOAT, state.pressure.row(y));
+    }
+    checkGLError("restoreCheckpoint");
+
+    stepCount = state.step;
+    simulationTime = state.time;
+    return true;
+}
+
+void GPUSolver::setPressureSolver(PressureSolver solver, MultigridCycle cycle, int cycles) {
+    pressureSolver = solver;
+    multigridCycle = cycle;
+    multigridCycles = cycles;
+}
+
+void GPUSolver::setIterationLimits(int diffusion, int pressure) {
+    diffusionIterations = diffusion;
+    pressureIterations = pressure;
+}
+
+void GPUSolver::setResidualTolerance(float diffusion, float pressure, int checkInterval) {
+    diffusionTolerance = diffusion;
+    pressureTolerance = pressure;
+    residualCheckInterval = std::max(1, checkInterval);
+}
+
+// Drops the check still in flight from an earlier solve
+void GPUSolver::resetResidualQueries() {
+    pendingResidual = 0;
+}
+
+// Queues the max-norm of field, times scale, as the check to read one interval from now
+void GPUSolver::issueResidualReduction(GLuint field, float scale) {
+    pendingResidual = solverReduction.reduce(field, gridWidth, gridHeight, 1, GPUReduction::Op::MinMax);
+    pendingResidualScale = scale;
+}
 
-    // Update display texture
-    glBindTexture(GL_TEXTURE_2D, displayTexture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, windowWidth, windowHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+// Reads the check issued one interval ago. Another interval of sweeps is queued behind its
+// fence, so waiting here does not drain the GPU. Returns false if there is no such check.
+bool GPUSolver::readPreviousResidual(float& residual) {
+    if (pendingResidual == 0) return false;
 
-    // Render to screen
+    GPUReduction::Result result;
+    bool ok = solverReduction.wait(pendingResidual, result);
+    pendingResidual = 0;
+    if (!ok) return false;
+    residual = pendingResidualScale * std::max(-result.min, result.max);
+    return true;
+}
+
+void GPUSolver::smoothPressure(const MultigridLevel& level, int sweeps) {
+    glUseProgram(projectionProgram);
+    glUniform1i(glGetUniformLocation(projectionProgram, "width"), level.width);
+    glUniform1i(glGetUniformLocation(projectionProgram, "height"), level.height);
+    glBindImageTexture(3, level.rhs, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+
+    int pressureBuffer = 0;
+    for (int iter = 0; iter < sweeps; iter++) {
+        // Red phase, then black phase
+        for (int mode = 1; mode <= 2; mode++) {
+            glUniform1i(glGetUniformLocation(projectionProgram, "mode"), mode);
+            glBindImageTexture(1, level.pressure[1-pressureBuffer], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glBindImageTexture(2, level.pressure[pressureBuffer], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+
+            glDispatchCompute((level.width + 15) / 16, (level.height + 15) / 16, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+            pressureBuffer = 1 - pressureBuffer;
+        }
+    }
+}
+
+void GPUSolver::runMultigridCycle(int level) {
+    const MultigridLevel& fine = multigridLevels[level];
+    if (level + 1 == static_cast<int>(multigridLevels.size())) {
+        smoothPressure(fine, 40);
+        return;
+    }
+    const MultigridLevel& coarse = multigridLevels[level + 1];
+
+    smoothPressure(fine, 2);
+    computePressureResidual(fine);
+
+    // Restrict it to the coarse right-hand side and clear the coarse correction
+    glUseProgram(multigridRestrictProgram);
+    glBindImageTexture(0, fine.residual, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, coarse.rhs, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glBindImageTexture(2, coarse.pressure[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glUniform1i(glGetUniformLocation(multigridRestrictProgram, "width"), coarse.width);
+    glUniform1i(glGetUniformLocation(multigridRestrictProgram, "height"), coarse.height);
+    glUniform1i(glGetUniformLocation(multigridRestrictProgram, "fineWidth"), fine.width);
+    glUniform1i(glGetUniformLocation(multigridRestrictProgram, "fineHeight"), fine.height);
+    glDispatchCompute((coarse.width + 15) / 16, (coarse.height + 15) / 16, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // A W-cycle visits each coarser level twice
+    runMultigridCycle(level + 1);
+    if (multigridCycle == MultigridCycle::W && level + 2 < static_cast<int>(multigridLevels.size())) {
+        runMultigridCycle(level + 1);
+    }
+
+    // Interpolate the coarse correction back and add it
+    glUseProgram(multigridProlongProgram);
+    glBindImageTexture(0, coarse.pressure[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, fine.pressure[0], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glUniform1i(glGetUniformLocation(multigridProlongProgram, "width"), fine.width);
+    glUniform1i(glGetUniformLocation(multigridProlongProgram, "height"), fine.height);
+    glUniform1i(glGetUniformLocation(multigridProlongProgram, "coarseWidth"), coarse.width);
+    glUniform1i(glGetUniformLocation(multigridProlongProgram, "coarseHeight"), coarse.height);
+    glDispatchCompute((fine.width + 15) / 16, (fine.height + 15) / 16, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    smoothPressure(fine, 2);
+}
+
+// Residual of the level's pressure equation into level.residual
+void GPUSolver::computePressureResidual(const MultigridLevel& level) {
+    glUseProgram(multigridResidualProgram);
+    glBindImageTexture(0, level.pressure[0], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(1, level.rhs, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+    glBindImageTexture(2, level.residual, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glUniform1i(glGetUniformLocation(multigridResidualProgram, "width"), level.width);
+    glUniform1i(glGetUniformLocation(multigridResidualProgram, "height"), level.height);
+    glDispatchCompute((level.width + 15) / 16, (level.height + 15) / 16, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+void GPUSolver::render() {
+    if (headless) return;
+
+    // Largest velocity magnitude for normalization; the fragment shader reads it where the
+    // reduction leaves it, so nothing comes back to the CPU
+    std::uint64_t speed = solverReduction.reduce(velocityTexture[currentBuffer], gridWidth, gridHeight, 2,
+                                                 GPUReduction::Op::Max);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, solverReduction.resultBuffer(speed));
+    checkGLError("Render: display scale");
+
+    // Render to screen straight from the velocity texture
     glClear(GL_COLOR_BUFFER_BIT);
     glUseProgram(displayShaderProgram);
 
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, displayTexture);
-    glUniform1i(glGetUniformLocation(displayShaderProgram, "displayTexture"), 0);
+    glBindTexture(GL_TEXTURE_2D, velocityTexture[currentBuffer]);
+    glUniform1i(glGetUniformLocation(displayShaderProgram, "velocityField"), 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, colormapTexture);
+    glUniform1i(glGetUniformLocation(displayShaderProgram, "colormap"), 1);
+    glUniform2i(glGetUniformLocation(displayShaderProgram, "displaySize"), windowWidth, windowHeight);
+    glActiveTexture(GL_TEXTURE0);
 
     glBindVertexArray(displayVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -597,14 +1023,16 @@ void GPUSolver::render() {
 
     glfwSwapBuffers(window);
 }
-void GPUSolver::uploadVelocityData(const std::vector<std::vector<Vec>>& velocities) {
+void GPUSolver::uploadVelocityData(const VelocityField& velocities) {
     std::vector<float> data(gridWidth * gridHeight * 2);
 
     for (int y = 0; y < gridHeight; y++) {
+        const double* u = velocities.u.row(y);
+        const double* v = velocities.v.row(y);
         for (int x = 0; x < gridWidth; x++) {
             int idx = (y * gridWidth + x) * 2;
-            data[idx] = static_cast<float>(velocities[y][x].x);
-            data[idx + 1] = static_cast<float>(velocities[y][x].y);
+            data[idx] = static_cast<float>(u[x]);
+            data[idx + 1] = static_cast<float>(v[x]);
         }
     }
 
@@ -613,19 +1041,21 @@ void GPUSolver::uploadVelocityData(const std::vector<std::vector<Vec>>& velociti
     checkGLError("uploadVelocityData");
 }
 
-void GPUSolver::downloadVelocityData(std::vector<std::vector<Vec>>& velocities) {
+void GPUSolver::downloadVelocityData(VelocityField& velocities) {
     std::vector<float> data(gridWidth * gridHeight * 2);
 
     glBindTexture(GL_TEXTURE_2D, velocityTexture[currentBuffer]);
     glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, data.data());
     checkGLError("downloadVelocityData");
 
-    velocities.resize(gridHeight);
+    velocities.resize(gridHeight, gridWidth);
     for (int y = 0; y < gridHeight; y++) {
-        velocities[y].resize(gridWidth);
+        double* u = velocities.u.row(y);
+        double* v = velocities.v.row(y);
         for (int x = 0; x < gridWidth; x++) {
             int idx = (y * gridWidth + x) * 2;
-            velocities[y][x] = Vec(data[idx], data[idx + 1]);
+            u[x] = data[idx];
+            v[x] = data[idx + 1];
         }
     }
 }
@@ -635,32 +1065,19 @@ void GPUSolver::addForce(int x, int y, float fx, float fy) {
     x = std::max(0, std::min(x, gridWidth - 1));
     y = std::max(0, std::min(y, gridHeight - 1));
 
-    // Download current velocity field
-    std::vector<std::vector<Vec>> velocities;
-    downloadVelocityData(velocities);
-
-    // Apply force in a small radius
-    const int radius = 5;
-    const float maxForce = 2.0f;  // Maximum force magnitude
-
-    for (int dy = -radius; dy <= radius; dy++) {
-        for (int dx = -radius; dx <= radius; dx++) {
-            int px = x + dx;
-            int py = y + dy;
-
-            if (px >= 0 && px < gridWidth && py >= 0 && py < gridHeight) {
-                float dist = std::sqrt(dx*dx + dy*dy);
-                if (dist <= radius) {
-                    float factor = (1.0f - dist/radius) * maxForce;
-                    velocities[py][px].x += fx * factor;
-                    velocities[py][px].y += fy * factor;
-                }
-            }
-        }
-    }
+    // Force in a small radius, strongest at the centre
+    ForceSplat splat;
+    splat.x = static_cast<float>(x);
+    splat.y = static_cast<float>(y);
+    splat.fx = fx;
+    splat.fy = fy;
+    addSplat(splat);
+}
 
-    // Upload modified velocity field
-    uploadVelocityData(velocities);
+void GPUSolver::addSplat(const ForceSplat& splat) {
+    if (splat.radius > 0) {
+        pendingSplats.push_back(splat);
+    }
 }
 
 void GPUSolver::addDye(int x, int y, float intensity) {
@@ -5,20 +5,34 @@
 #include <vector>
 #include <string>
 #include "grid.hpp"
+#include "gpu_reduction.hpp"
 #include "shader_manager.hpp"
 
+// A disc of force added to the velocity: cells within radius of (x, y) get
+// (fx, fy) * strength * (1 - distance / radius)^falloff
+struct ForceSplat {
+    float x, y;
+    float fx, fy;
+    float radius = 5;
+    float strength = 2;
+    float falloff = 1;
+    float padding = 0;
+};
+static_assert(sizeof(ForceSplat) == 32, "ForceSplat must match the force shader's std430 layout");
+
 class GPUSolver {
 private:
     // OpenGL context and window
     ShaderManager shaderManager;
     GLFWwindow* window;
     int windowWidth, windowHeight;
+    bool headless;              // no display: the window is never shown and render() does nothing
 
     // GPU textures
     GLuint velocityTexture[2];  // Ping-pong buffers for velocity
     GLuint velocityBefore;      // For diffusion (stores "before" state)
     GLuint pressureTexture[2];  // Ping-pong buffers for pressure
-    GLuint divergenceTexture;   // Divergence field
+    GLuint divergenceTexture;   // Pressure right-hand side, -0.5 * (du/dx + dv/dy) in cell differences
 
     // Compute shaders
     GLuint advectionShader;
@@ -36,10 +50,40 @@ private:
     GLuint boundaryProgram;
     GLuint forceProgram;
 
-    // Display rendering
+    // Multigrid pressure solve; level 0 shares pressureTexture and divergenceTexture
+    struct MultigridLevel {
+        int width, height;
+        GLuint pressure[2];
+        GLuint rhs;
+        GLuint residual;
+    };
+    std::vector<MultigridLevel> multigridLevels;
+    GLuint multigridResidualShader, multigridRestrictShader, multigridProlongShader;
+    GLuint multigridResidualProgram, multigridRestrictProgram, multigridProlongProgram;
+
+    // Field statistics (max, sums, norms) reduced on the device and read back asynchronously,
+    // for callers of reduceField()
+    GPUReduction reduction;
+
+    // The solver's own reductions, kept apart so they never push a caller's result out of its
+    // ring: the display scale, and the residual max-norm of the early-exit checks. A check is
+    // read back one interval after it was issued, by which time the GPU has long finished it.
+    GPUReduction solverReduction;
+    std::uint64_t pendingResidual;      // ticket of the check in flight, 0 if none
+    float pendingResidualScale;
+
+    // Force splats queued since the last step, applied together by applyForces() in one
+    // dispatch over the cells they cover. The buffer mirrors the shader's std430 Splat array.
+    std::vector<ForceSplat> pendingSplats;
+    GLuint splatBuffer;
+    std::size_t splatBufferCapacity;
+
+    // Display rendering, entirely on the GPU: solverReduction finds the largest velocity
+    // magnitude, and the fragment shader reads it from the result buffer, samples the velocity
+    // texture, normalizes by it and colours through the colormap lookup texture
     GLuint displayVAO;
     GLuint displayVBO;
-    GLuint displayTexture;
+    GLuint colormapTexture;
     GLuint displayShaderProgram;
 
     // Grid dimensions
@@ -50,10 +94,38 @@ private:
     float viscosity;
     float alpha;
 
+    // Pressure solver selection
+    PressureSolver pressureSolver;
+    MultigridCycle multigridCycle;
+    int multigridCycles;
+
+    // Iteration limits and early exit; a tolerance of 0 always runs the full count
+    int diffusionIterations;
+    int pressureIterations;
+    float diffusionTolerance;
+    float pressureTolerance;
+    int residualCheckInterval;
+    SolveStats lastDiffusionSolve;
+    SolveStats lastPressureSolve;
+
     // Current buffer index (for ping-pong)
     int currentBuffer;
 
+    // Steps taken by step() and the simulated time they cover
+    long stepCount;
+    double simulationTime;
+
+    // Checkpoint readback (checkpoint.hpp): the GPU copies velocity and pressure into a pixel
+    // pack buffer and fences the copy; the state is mapped once the fence has passed, so the
+    // step loop never waits for the transfer
+    SimulationConfig checkpointConfig;
+    GLuint checkpointBuffer;
+    GLsync checkpointFence;
+    long checkpointStep;
+    double checkpointTime;
+
     // Helper functions
+    bool createWindow(bool useNullPlatform);
     GLuint createTexture(int width, int height, GLenum format);
     void swapBuffers();
     void applyPressureGradient();
@@ -61,33 +133,75 @@ private:
     bool initializeShaders();
     bool initializeDisplayShader();
     bool initializeTextures();
+    bool initializeMultigrid();
+    void smoothPressure(const MultigridLevel& level, int sweeps);
+    void runMultigridCycle(int level);
+    void computePressureResidual(const MultigridLevel& level);
+    void resetResidualQueries();
+    void issueResidualReduction(GLuint field, float scale);
+    bool readPreviousResidual(float& residual);
     bool validateShaderProgram(GLuint program, const char* name);
 
 public:
-    GPUSolver(int width, int height);
+    explicit GPUSolver(const SimulationConfig& config);
     ~GPUSolver();
 
-    // Initialization and cleanup
-    bool initialize();
+    // Initialization and cleanup. A headless solver needs no display server and runs without
+    // vsync, so steps go as fast as the device allows; it has no display path.
+    bool initialize(bool headlessMode = false);
     void cleanup();
+    bool isHeadless() const { return headless; }
+
+    // Waits until the GPU has finished every step issued so far
+    void finish();
 
     // GPU simulation steps
     void applyForces();
     void diffuse();
     void advect();
     void project();
+    // One full step: forces, diffusion, advection and projection
+    void step();
+    void setPressureSolver(PressureSolver solver, MultigridCycle cycle = MultigridCycle::V, int cycles = 2);
+    void setIterationLimits(int diffusion, int pressure);
+    void setResidualTolerance(float diffusion, float pressure, int checkInterval = 5);
+    const SolveStats& getLastDiffusionSolve() const { return lastDiffusionSolve; }
+    const SolveStats& getLastPressureSolve() const { return lastPressureSolve; }
+    long getStepCount() const { return stepCount; }
+    double getTime() const { return simulationTime; }
+
+    // Checkpoint/restart. requestCheckpoint() queues an asynchronous readback of the state after
+    // the last step, or returns false while an earlier one is still pending. pollCheckpoint()
+    // fills state once that readback has landed and returns false, without blocking, until
+    // then. restoreCheckpoint() uploads a state read with readCheckpoint(); the run then
+    // continues bit for bit.
+    bool requestCheckpoint();
+    bool checkpointPending() const { return checkpointFence != nullptr; }
+    bool pollCheckpoint(SolverState<float>& state);
+    bool restoreCheckpoint(const SolverState<float>& state);
+
+    // Field statistics without a readback of the field. reduceField() queues the reduction
+    // behind the steps issued so far; collect the result with getReduction().poll() or wait().
+    // Velocity reduces the speed of each cell. PressureRhs is the right-hand side the last
+    // projection solved for, -0.5 * ((u[x+1] - u[x-1]) + (v[y+1] - v[y-1])): the velocity
+    // divergence scaled by -dx, not the divergence itself. Pressure is the pressure it solved for.
+    enum class Field { Velocity, Pressure, PressureRhs };
+    std::uint64_t reduceField(Field field, GPUReduction::Op op);
+    GPUReduction& getReduction() { return reduction; }
 
     // Data transfer
-    void uploadVelocityData(const std::vector<std::vector<Vec>>& velocities);
-    void downloadVelocityData(std::vector<std::vector<Vec>>& velocities);
+    void uploadVelocityData(const VelocityField& velocities);
+    void downloadVelocityData(VelocityField& velocities);
 
     // Rendering
     void render();
     bool shouldClose() const { return glfwWindowShouldClose(window); }
     void pollEvents() { glfwPollEvents(); }
 
-    // User interaction
+    // User interaction. Forces are queued and applied at the start of the next step, all of
+    // them in one dispatch, so adding one costs no transfer of the field.
     void addForce(int x, int y, float fx, float fy);
+    void addSplat(const ForceSplat& splat);
     void addDye(int x, int y, float intensity);
 
     // Getters
@@ -1,262 +1,398 @@
 #include "grid.hpp"
+#include <algorithm>
 #include <iostream>
 #include <cmath>
-#include <fstream>
-
-const int width = 256;
-const int height = 256;
-const double kinematicViscosity = 0.1;
-const int diffusionIterations = 50;
-const int projectionIterations = 20;
-const int dx = 1;
-
-void grid::init() {
-    currentVelocities.resize(width, vector<Vec>(height, Vec(0, 0)));
-    nextVelocities.resize(width, vector<Vec>(height, Vec(0, 0)));
-    pressureForces.resize(width, vector<double>(height, 0.0));
-
-    timeStep = 0.5;
-    this->alpha = kinematicViscosity * timeStep / (dx * dx);
-}
 
-void grid::forces() {
-    for (int i = 0; i < width; i++) {
-        for (int j = 0; j < height; j++) {
-            Vec force;
-            if (i < 140 && i >= 116) {
-                force = Vec(2, 0);
-            }
-            else {
-                force = Vec(0, 0);
-            }
+template <typename Real>
+void BasicGrid<Real>::init(const SimulationConfig& config) {
+    this->config = config;
+    width = config.width;
+    height = config.height;
+    kinematicViscosity = config.viscosity;
+    dx = config.dx;
+    diffusionIterations = config.diffusionIterations;
+    projectionIterations = config.projectionIterations;
+    diffusionTolerance = config.diffusionTolerance;
+    projectionTolerance = config.projectionTolerance;
+    residualCheckInterval = config.residualCheckInterval;
+    boundaryCondition = config.boundaryCondition;
+    pressureSolver = config.pressureSolver;
+    multigrid.cycleType = config.multigridCycle;
+    multigridCycles = config.multigridCycles;
+    pcg.preconditioner = config.preconditioner;
+    pcg.tolerance = config.cgTolerance;
+    pcg.maxIterations = config.cgMaxIterations;
+    diffusionBlockDepth = config.diffusionBlockDepth;
+    blockedJacobi.depth = config.diffusionBlockDepth;
+    blockedJacobi.tileRows = config.diffusionTileRows;
+
+    // stencil operands carry a one-cell halo so sweeps never clamp indices
+    currentVelocities.resize(height, width, 1);
+    nextVelocities.resize(height, width, 1);
+    pressureForces.resize(height, width, 0.0, 1);
+    diffusionSource.resize(height, width, 1);
+    divergence.resize(height, width, 0.0);
+    rowResiduals.resize(height, 1, 0.0);
+    multigrid.resize(height, width);
+    pcg.resize(height, width);
+    pcg.multigrid = &multigrid;
+    frameInterpolator.resize(height, width);
+    if (diffusionBlockDepth > 1) {
+        blockedJacobi.resize(height, width, 1);
+    }
 
-            Vec toAdd(force.x * this->timeStep, force.y * this->timeStep);
-            this->currentVelocities[i][j] = Vec::add(this->currentVelocities[i][j], toAdd);
-        }
+    setSimdLevel(detectSimdLevel());
+
+    timeStep = Real(config.timeStep);
+    time = 0;
+    stepCount = 0;
+    this->alpha = Real(kinematicViscosity * timeStep / (dx * dx));
+}
+
+template <typename Real>
+void BasicGrid<Real>::setThreadCount(int threads) {
+    if (threads > 1) {
+        pool = make_unique<ThreadPool>(threads);
+    }
+    else {
+        pool.reset();
+    }
+    multigrid.pool = pool.get();
+    pcg.pool = pool.get();
+    blockedJacobi.pool = pool.get();
+    if (diffusionBlockDepth > 1) {
+        blockedJacobi.resize(height, width, pool ? pool->size() : 1);
     }
-    cout << "forces applied" << endl;
 }
 
-Vec grid::getBoundaryVelocity(int i, int j, const vector<vector<Vec>>& velocities) {
-    int clamped_i = max(0, min(width - 1, i));
-    int clamped_j = max(0, min(height - 1, j));
-    return velocities[clamped_i][clamped_j];
+template <typename Real>
+void BasicGrid<Real>::setSimdLevel(SimdLevel level) {
+    // the fine-grid sweeps get the set specialised for this width, if there is one;
+    // multigrid runs every level size through the same kernels, so it keeps the generic set
+    kernels = &stencilKernels<Real>(level, width);
+    blockedJacobi.kernels = kernels;
+    multigrid.kernels = &stencilKernels<Real>(level);
 }
 
-double grid::getBoundaryPressure(int i, int j, const vector<vector<double>> pressureForces) {
-    int clamped_i = max(0, min(width - 1, i));
-    int clamped_j = max(0, min(height - 1, j));
-    return pressureForces[clamped_i][clamped_j];
+template <typename Real>
+void BasicGrid<Real>::forces() {
+    // a horizontal jet through the middle rows, 3/32 of the grid tall (rows 116-139 at 256)
+    int bandHeight = height * 3 / 32;
+    int bandBegin = height / 2 - bandHeight / 2;
+    int bandEnd = bandBegin + bandHeight;
+    forEachRowBand([&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            for (int j = 0; j < width; j++) {
+                Vector force;
+                if (i < bandEnd && i >= bandBegin) {
+                    force = Vector(2, 0);
+                }
+                else {
+                    force = Vector(0, 0);
+                }
+
+                Vector toAdd(force.x * this->timeStep, force.y * this->timeStep);
+                this->currentVelocities.set(i, j, Vector::add(this->currentVelocities.at(i, j), toAdd));
+            }
+        }
+    });
+    cout << "forces applied" << endl;
 }
 
-void grid::diffusion() {
-    vector<vector<Vec>> before = currentVelocities;
+template <typename Real>
+void BasicGrid<Real>::diffusion() {
+    // The field entering diffusion is kept in diffusionSource; the first sweep reads its
+    // neighbours from there too, later sweeps ping-pong between current and next
+    const Velocity& before = diffusionSource;
+    diffusionSource.swap(currentVelocities);
+    Real denominator = 1 + 4 * alpha;
+    lastDiffusionSolve = { diffusionIterations, -1 };
+    blockedJacobi.boundaryCondition = boundaryCondition;
+
+    int iter = 0;
+    while (iter < diffusionIterations) {
+        Velocity& source = (iter == 0) ? diffusionSource : currentVelocities;
+        source.fillBoundary(boundaryCondition);
+
+        // a block never runs past the next residual check, so checks see the same iterates
+        int block = min(diffusionBlockDepth, diffusionIterations - iter);
+        if (diffusionTolerance > 0) {
+            block = min(block, residualCheckInterval - iter % residualCheckInterval);
+        }
+        bool check = diffusionTolerance > 0 && (iter + block) % residualCheckInterval == 0;
+        iter += block;
 
-    for (int iter = 0; iter < diffusionIterations; iter++) {
-        for (int i = 0; i < width; i++) {
-            for (int j = 0; j < height; j++) {
-                Vec left = getBoundaryVelocity(i - 1, j, currentVelocities);
-                Vec right = getBoundaryVelocity(i + 1, j, currentVelocities);
-                Vec up = getBoundaryVelocity(i, j - 1, currentVelocities);
-                Vec down = getBoundaryVelocity(i, j + 1, currentVelocities);
+        if (block > 1) {
+            blockedJacobi.run(nextVelocities, before, source, block, alpha, denominator,
+                              check ? &rowResiduals : nullptr);
+        }
+        else {
+            forEachRowBand([&](int rowBegin, int rowEnd) {
+                for (int i = rowBegin; i < rowEnd; i++) {
+                    Real* uOut = nextVelocities.u.row(i);
+                    Real* vOut = nextVelocities.v.row(i);
+                    kernels->jacobiRow(uOut, before.u.row(i), source.u.row(i - 1),
+                                       source.u.row(i), source.u.row(i + 1), width, alpha, denominator);
+                    kernels->jacobiRow(vOut, before.v.row(i), source.v.row(i - 1),
+                                       source.v.row(i), source.v.row(i + 1), width, alpha, denominator);
+                    if (check) {
+                        // a Jacobi update is the residual of the previous iterate divided by the diagonal
+                        const Real* uIn = source.u.row(i);
+                        const Real* vIn = source.v.row(i);
+                        Real change = 0;
+                        for (int j = 0; j < width; j++) {
+                            change = max(change, max(abs(uOut[j] - uIn[j]), abs(vOut[j] - vIn[j])));
+                        }
+                        rowResiduals(i, 0) = double(denominator) * change;
+                    }
+                }
+            });
+        }
+        currentVelocities.swap(nextVelocities);
 
-                double denominator = 1 + 4 * alpha;
-                nextVelocities[i][j].x = (before[i][j].x + alpha * (left.x + right.x + up.x + down.x)) / denominator;
-                nextVelocities[i][j].y = (before[i][j].y + alpha * (left.y + right.y + up.y + down.y)) / denominator;
+        if (check) {
+            lastDiffusionSolve.residual = maxRowResidual();
+            if (lastDiffusionSolve.residual < diffusionTolerance) {
+                lastDiffusionSolve.iterations = iter;
+                break;
             }
         }
-        currentVelocities = nextVelocities;
+    }
+    if (diffusionIterations == 0) {
+        currentVelocities.swap(diffusionSource);
+    }
+    if (diffusionTolerance > 0) {
+        cout << "diffusion: " << lastDiffusionSolve.iterations << " iterations, residual "
+             << lastDiffusionSolve.residual << endl;
     }
     cout << "diffusion applied" << endl;
 }
 
-void grid::advection() {
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            int x = j;
-            int y = height - i - 1;
-            double x_new = max(min(x - currentVelocities[i][j].x * timeStep, (double)width - 1), (double)0);
-            double y_new = max(min(y - currentVelocities[i][j].y * timeStep, (double)height - 1), (double)0);
-            double s = x_new - floor(x_new);
-            double t = y_new - floor(y_new);
-            int lowX = (int)floor(x_new);
-            int lowY = (int)floor(y_new);
-            int store = lowY;
-            lowY = lowX;
-            lowX = height - 1 - store;
-            Vec newVelocity;
-            newVelocity.x = (1 - s) * (1 - t) * currentVelocities[lowX][lowY].x + s * (1 - t) * currentVelocities[
-                min(lowX + 1, width - 1)][lowY].x + (1 - s) * t * currentVelocities[lowX][
-                    min(lowY + 1, height - 1)].x + s * t * currentVelocities[min(lowX + 1, width - 1)][min(
-                        lowY + 1, height - 1)].x;
-                    newVelocity.y = (1 - s) * (1 - t) * currentVelocities[lowX][lowY].y + s * (1 - t) * currentVelocities[
-                        min(lowX + 1, width - 1)][lowY].y + (1 - s) * t * currentVelocities[lowX][
-                            min(lowY + 1, height - 1)].y + s * t * currentVelocities[min(lowX + 1, width - 1)][min(
-                                lowY + 1, height - 1)].y;
-                            nextVelocities[i][j] = newVelocity;
+template <typename Real>
+void BasicGrid<Real>::advection() {
+    const Field2D<Real>& u = currentVelocities.u;
+    const Field2D<Real>& v = currentVelocities.v;
+    // the bilinear stencil reaches one cell past the far edges, into the halo
+    currentVelocities.fillBoundary(boundaryCondition);
+
+    forEachRowBand([&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            for (int j = 0; j < width; j++) {
+                int x = j;
+                int y = height - i - 1;
+                Real x_new = max(min(x - u(i, j) * timeStep, (Real)width - 1), (Real)0);
+                Real y_new = max(min(y - v(i, j) * timeStep, (Real)height - 1), (Real)0);
+                Real s = x_new - floor(x_new);
+                Real t = y_new - floor(y_new);
+                int lowX = (int)floor(x_new);
+                int lowY = (int)floor(y_new);
+                int store = lowY;
+                lowY = lowX;
+                lowX = height - 1 - store;
+                int highX = lowX + 1;
+                int highY = lowY + 1;
+
+                nextVelocities.u(i, j) = (1 - s) * (1 - t) * u(lowX, lowY) + s * (1 - t) * u(highX, lowY) +
+                    (1 - s) * t * u(lowX, highY) + s * t * u(highX, highY);
+                nextVelocities.v(i, j) = (1 - s) * (1 - t) * v(lowX, lowY) + s * (1 - t) * v(highX, lowY) +
+                    (1 - s) * t * v(lowX, highY) + s * t * v(highX, highY);
+            }
         }
-    }
-    currentVelocities = nextVelocities;
+    });
+    currentVelocities.swap(nextVelocities);
     cout << "advection applied" << endl;
 }
 
-void grid::projection() {
-    vector<vector<double>> divergence(height, vector<double>(width, 0));
-
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            double u_right = getBoundaryVelocity(i, j + 1, currentVelocities).x;
-            double u_left = getBoundaryVelocity(i, j - 1, currentVelocities).x;
-            double v_up = getBoundaryVelocity(i - 1, j, currentVelocities).y;
-            double v_down = getBoundaryVelocity(i + 1, j, currentVelocities).y;
+template <typename Real>
+void BasicGrid<Real>::projection() {
+    currentVelocities.fillBoundary(boundaryCondition);
+    forEachRowBand([&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            kernels->divergenceRow(divergence.row(i), currentVelocities.u.row(i),
+                                   currentVelocities.v.row(i - 1), currentVelocities.v.row(i + 1), width);
+        }
+    });
 
-            divergence[i][j] = -0.5 * ((u_right - u_left) + (v_up - v_down));
+    if (pressureSolver == PressureSolver::Multigrid) {
+        multigrid.boundaryCondition = boundaryCondition;
+        multigrid.solve(pressureForces, divergence, multigridCycles);
+        lastPressureSolve = { multigridCycles, -1 };
+    }
+    else if (pressureSolver == PressureSolver::ConjugateGradient) {
+        pcg.boundaryCondition = boundaryCondition;
+        lastPressureSolve = pcg.solve(pressureForces, divergence);
+        cout << "pressure solve: " << lastPressureSolve.iterations << " iterations, residual "
+             << lastPressureSolve.residual << endl;
+        if (!lastPressureSolve.converged) {
+            cerr << "Warning: conjugate gradient stopped at residual " << lastPressureSolve.residual
+                 << " after " << lastPressureSolve.iterations << " iterations, above cg-tol " << pcg.tolerance << endl;
         }
     }
-
-    int iterations = projectionIterations;
-    while (iterations--) {
-        cout << iterations << endl;
-
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                if ((i + j) % 2 == 0) {
-                    double p_left = getBoundaryPressure(i, j - 1, pressureForces);
-                    double p_right = getBoundaryPressure(i, j + 1, pressureForces);
-                    double p_up = getBoundaryPressure(i - 1, j, pressureForces);
-                    double p_down = getBoundaryPressure(i + 1, j, pressureForces);
-
-                    this->pressureForces[i][j] = (divergence[i][j] + p_right + p_left + p_up + p_down) / 4;
-                }
+    else {
+        lastPressureSolve = { projectionIterations, -1 };
+        int sweeps = 0;
+        while (sweeps < projectionIterations) {
+            // red cells (i + j even), then black cells; the halo is refreshed before each half.
+            // Cells of one colour only read the other colour, so each half splits freely into row bands.
+            for (int color = 0; color < 2; color++) {
+                pressureForces.fillBoundary(boundaryCondition);
+                forEachRowBand([&](int rowBegin, int rowEnd) {
+                    for (int i = rowBegin; i < rowEnd; i++) {
+                        // first column of this colour in row i
+                        kernels->redBlackRow(pressureForces.row(i), pressureForces.row(i - 1), pressureForces.row(i + 1),
+                                             divergence.row(i), width, (i + color) % 2);
+                    }
+                });
             }
-        }
-
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                if ((i + j) % 2 == 1) {
-                    double p_left = getBoundaryPressure(i, j - 1, pressureForces);
-                    double p_right = getBoundaryPressure(i, j + 1, pressureForces);
-                    double p_up = getBoundaryPressure(i - 1, j, pressureForces);
-                    double p_down = getBoundaryPressure(i + 1, j, pressureForces);
 
-                    this->pressureForces[i][j] = (divergence[i][j] + p_right + p_left + p_up + p_down) / 4;
+            sweeps++;
+            if (projectionTolerance > 0 && sweeps % residualCheckInterval == 0) {
+                lastPressureSolve.residual = pressureResidual();
+                if (lastPressureSolve.residual < projectionTolerance) {
+                    lastPressureSolve.iterations = sweeps;
+                    break;
                 }
             }
         }
+        if (projectionTolerance > 0) {
+            cout << "pressure solve: " << lastPressureSolve.iterations << " iterations, residual "
+                 << lastPressureSolve.residual << endl;
+        }
     }
 
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            double p_left = getBoundaryPressure(i, j - 1, pressureForces);
-            double p_right = getBoundaryPressure(i, j + 1, pressureForces);
-            double p_up = getBoundaryPressure(i - 1, j, pressureForces);
-            double p_down = getBoundaryPressure(i + 1, j, pressureForces);
-
-            double xGradient = (p_right - p_left) / 2;
-            double yGradient = (p_up - p_down) / 2;
-            currentVelocities[i][j].x -= xGradient;
-            currentVelocities[i][j].y -= yGradient;
+    pressureForces.fillBoundary(boundaryCondition);
+    forEachRowBand([&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            kernels->gradientRow(currentVelocities.u.row(i), currentVelocities.v.row(i), pressureForces.row(i - 1),
+                                 pressureForces.row(i), pressureForces.row(i + 1), width);
         }
-    }
+    });
     cout << "projection applied" << endl;
 }
 
-void grid::renderNext() {
+// Largest entry of rowResiduals; each band writes its own rows, so the result does not depend on the pool
+template <typename Real>
+double BasicGrid<Real>::maxRowResidual() {
+    double result = 0;
+    for (int i = 0; i < height; i++) {
+        result = max(result, rowResiduals(i, 0));
+    }
+    return result;
+}
+
+// Max-norm of divergence - (4p - neighbours), the equation the red-black sweeps solve
+template <typename Real>
+double BasicGrid<Real>::pressureResidual() {
+    pressureForces.fillBoundary(boundaryCondition);
+    forEachRowBand([&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            const Real* up = pressureForces.row(i - 1);
+            const Real* mid = pressureForces.row(i);
+            const Real* down = pressureForces.row(i + 1);
+            const Real* b = divergence.row(i);
+            Real largest = 0;
+            for (int j = 0; j < width; j++) {
+                largest = max(largest, abs(b[j] - (4 * mid[j] - (mid[j - 1] + mid[j + 1] + up[j] + down[j]))));
+            }
+            rowResiduals(i, 0) = largest;
+        }
+    });
+    return maxRowResidual();
+}
+
+template <typename Real>
+void BasicGrid<Real>::renderNext() {
+    size_t allocationsBefore = fieldAllocationCount;
+
     this->forces();
     this->diffusion();
     this->advection();
     this->projection();
-}
 
-void grid::frameGen() {
-    for (int i = 0; i < frames.size() - 1; i++) {
-        generatedFrames.push_back(frames[i]);
-        for (int j = 0; j < 10; j++) {
-            vector<vector<Vec>> gen(height, vector<Vec>(width));
+    lastStepAllocations = fieldAllocationCount - allocationsBefore;
+    time += timeStep;
+    stepCount++;
 
-            for (int r = 0; r < height; r++) {
-                for (int c = 0; c < width; c++) {
-                    gen[r][c].x = (frames[i][r][c].x * (10 - j) + frames[i + 1][r][c].x * (j + 1)) / 11;
-                    gen[r][c].y = (frames[i][r][c].y * (10 - j) + frames[i + 1][r][c].y * (j + 1)) / 11;
-                }
-            }
-            generatedFrames.push_back(gen);
-        }
+    if (frameSink) {
+        frameInterpolator.push(currentVelocities, time, *frameSink);
     }
-    generatedFrames.push_back(frames.back());
 }
 
-void grid::writeFramesToFile(const string& filename) {
-    ofstream outFile(filename, ios::binary);
-    if (!outFile.is_open()) {
-        cerr << "Error: Could not open file " << filename << " for writing" << endl;
-        return;
+template <typename Real>
+void BasicGrid<Real>::saveState(SolverState<Real>& state) const {
+    state.config = config;
+    state.config.precision = precisionOf<Real>();
+    state.step = stepCount;
+    state.time = time;
+    state.resize();
+    for (int i = 0; i < height; i++) {
+        std::copy(currentVelocities.u.row(i), currentVelocities.u.row(i) + width, state.velocity.u.row(i));
+        std::copy(currentVelocities.v.row(i), currentVelocities.v.row(i) + width, state.velocity.v.row(i));
+        std::copy(pressureForces.row(i), pressureForces.row(i) + width, state.pressure.row(i));
     }
+}
 
-    int numFrames = generatedFrames.size();
-    outFile.write(reinterpret_cast<const char*>(&numFrames), sizeof(int));
-    outFile.write(reinterpret_cast<const char*>(&width), sizeof(int));
-    outFile.write(reinterpret_cast<const char*>(&height), sizeof(int));
-
-    for (int f = 0; f < numFrames; f++) {
-        for (int i = 0; i < height; i++) {
-            for (int j = 0; j < width; j++) {
-                double vx = generatedFrames[f][i][j].x;
-                double vy = generatedFrames[f][i][j].y;
-                outFile.write(reinterpret_cast<const char*>(&vx), sizeof(double));
-                outFile.write(reinterpret_cast<const char*>(&vy), sizeof(double));
-            }
-        }
-        if ((f + 1) % 100 == 0) {
-            cout << "Written " << (f + 1) << " frames..." << endl;
-        }
+template <typename Real>
+bool BasicGrid<Real>::restoreState(const SolverState<Real>& state) {
+    if (state.velocity.rows() != height || state.velocity.cols() != width) {
+        cerr << "Error: checkpoint is " << state.velocity.cols() << "x" << state.velocity.rows()
+             << " but the grid is " << width << "x" << height << endl;
+        return false;
+    }
+    for (int i = 0; i < height; i++) {
+        std::copy(state.velocity.u.row(i), state.velocity.u.row(i) + width, currentVelocities.u.row(i));
+        std::copy(state.velocity.v.row(i), state.velocity.v.row(i) + width, currentVelocities.v.row(i));
+        std::copy(state.pressure.row(i), state.pressure.row(i) + width, pressureForces.row(i));
     }
+    stepCount = state.step;
+    time = state.time;
+    if (frameSink) {
+        frameInterpolator.seed(currentVelocities, time);
+    }
+    return true;
+}
 
-    outFile.close();
-    cout << "Successfully wrote " << numFrames << " frames to " << filename << endl;
+template <typename Real>
+int BasicGrid<Real>::interpolatedFrameCount() const {
+    return frames.empty() ? 0 : (static_cast<int>(frames.size()) - 1) * (frameInterpolator.inBetweens + 1) + 1;
 }
 
-void grid::readFramesFromFile(const string& filename) {
-    ifstream inFile(filename, ios::binary);
-    if (!inFile.is_open()) {
-        cerr << "Error: Could not open file " << filename << " for reading" << endl;
+template <typename Real>
+void BasicGrid<Real>::interpolatedFrame(int index, Velocity& out) const {
+    int period = frameInterpolator.inBetweens + 1;
+    const Velocity& from = frames[index / period];
+    if (out.rows() != from.rows() || out.cols() != from.cols()) {
+        out.resize(from.rows(), from.cols());
+    }
+    if (index % period == 0) {
+        for (int i = 0; i < from.rows(); i++) {
+            std::copy(from.u.row(i), from.u.row(i) + from.cols(), out.u.row(i));
+            std::copy(from.v.row(i), from.v.row(i) + from.cols(), out.v.row(i));
+        }
         return;
     }
+    FrameInterpolator<Real>::blend(from, frames[index / period + 1], index % period - 1, period - 1, out);
+}
 
-    int numFrames;
-    inFile.read(reinterpret_cast<char*>(&numFrames), sizeof(int));
+template <typename Real>
+void BasicGrid<Real>::writeFramesToFile(const string& filename) {
+    // one frame per step; players compute the in-betweens
+    writeFrames(filename, frames, width, height, timeStep, frameInterpolator.inBetweens);
+}
 
+template <typename Real>
+void BasicGrid<Real>::readFramesFromFile(const string& filename) {
     int fileWidth, fileHeight;
-    inFile.read(reinterpret_cast<char*>(&fileWidth), sizeof(int));
-    inFile.read(reinterpret_cast<char*>(&fileHeight), sizeof(int));
-
+    if (!readFrames(filename, frames, fileWidth, fileHeight)) {
+        return;
+    }
     if (fileWidth != width || fileHeight != height) {
         cerr << "Error: Grid dimensions mismatch!" << endl;
         cerr << "File has " << fileWidth << "x" << fileHeight << " but current grid is "
             << width << "x" << height << endl;
-        inFile.close();
-        return;
-    }
-
-    generatedFrames.clear();
-    generatedFrames.resize(numFrames);
-
-    for (int f = 0; f < numFrames; f++) {
-        generatedFrames[f].resize(height);
-        for (int i = 0; i < height; i++) {
-            generatedFrames[f][i].resize(width);
-            for (int j = 0; j < width; j++) {
-                double vx, vy;
-                inFile.read(reinterpret_cast<char*>(&vx), sizeof(double));
-                inFile.read(reinterpret_cast<char*>(&vy), sizeof(double));
-                generatedFrames[f][i][j] = Vec(vx, vy);
-            }
-        }
-        if ((f + 1) % 100 == 0) {
-            cout << "Read " << (f + 1) << " frames..." << endl;
-        }
+        frames.clear();
     }
+}
 
-    inFile.close();
-    cout << "Successfully read " << numFrames << " frames from " << filename << endl;
-}
\ No newline at end of file
+template class BasicGrid<float>;
+template class BasicGrid<double>;
\ No newline at end of file
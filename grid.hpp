@@ -2,44 +2,136 @@
 #define GRID_HPP
 
 #include "coords.hpp"
+#include "blocked_jacobi.hpp"
+#include "checkpoint.hpp"
+#include "field2d.hpp"
+#include "frame_io.hpp"
+#include "frame_sink.hpp"
+#include "stencil_kernels.hpp"
+#include "multigrid.hpp"
+#include "pcg.hpp"
+#include "simulation_config.hpp"
+#include "thread_pool.hpp"
+#include <memory>
 #include <vector>
 #include <string>
 #include <fstream>
-extern const int width;
-extern const int height;
-extern const double kinematicViscosity;
-extern const int diffusionIterations;
-extern const int projectionIterations;
-extern const int dx;
 using namespace std;
 
-class grid {
+// The CPU solver, templated on the scalar type of its fields. Float halves the bytes every
+// sweep moves; reductions and residuals are still accumulated in double.
+template <typename Real>
+class BasicGrid {
 public:
-    vector <vector <Vec>> currentVelocities;
-    vector <vector <Vec>> nextVelocities;
-    vector <vector <double>> pressureForces;
-    double timeStep;
-    double alpha;
+    using Vector = BasicVec<Real>;
+    using Velocity = BasicVelocityField<Real>;
 
-    vector <vector<vector<Vec>>> frames;
-    vector <vector<vector<Vec>>> generatedFrames;
+    // the SimulationConfig passed to init(); size and constants below are copied from it
+    SimulationConfig config;
+    int width = 0;
+    int height = 0;
+    double kinematicViscosity = 0;
+    double dx = 1;
+    int diffusionIterations = 0;
+    int projectionIterations = 0;
+
+    Velocity currentVelocities;
+    Velocity nextVelocities;
+    Field2D<Real> pressureForces;
+
+    // scratch fields, allocated once in init() and reused by every step
+    Velocity diffusionSource;
+    Field2D<Real> divergence;
+    Field2D<double> rowResiduals;
+
+    Real timeStep;
+    Real alpha;
+
+    // simulated time and steps taken, advanced by renderNext()
+    double time = 0;
+    long stepCount = 0;
+
+    // how halo cells are filled before each stencil sweep
+    BoundaryCondition boundaryCondition = BoundaryCondition::Clamp;
+
+    // pressure solve used by projection(); multigrid runs multigridCycles cycles per step,
+    // conjugate gradient runs until pcg.tolerance or pcg.maxIterations
+    PressureSolver pressureSolver = PressureSolver::GaussSeidel;
+    MultigridSolver<Real> multigrid;
+    int multigridCycles = 2;
+    PcgSolver<Real> pcg;
+
+    // diffusion sweeps fused per cache tile; a depth of 1 leaves them as plain full-field sweeps
+    BlockedJacobi<Real> blockedJacobi;
+    int diffusionBlockDepth = 1;
+
+    // Early exit for the diffusion and Gauss-Seidel sweeps: every residualCheckInterval sweeps the
+    // max-norm residual is measured and the loop stops once it is below the tolerance.
+    // A tolerance of 0 always runs the full diffusionIterations / projectionIterations.
+    double diffusionTolerance = 0;
+    double projectionTolerance = 0;
+    int residualCheckInterval = 5;
+
+    // iterations and final residual of the last step's solves
+    SolveStats lastDiffusionSolve;
+    SolveStats lastPressureSolve;
+
+    // Field2D allocations made by the last renderNext(); zero once the solver is warmed up
+    size_t lastStepAllocations = 0;
+
+    // row-band workers for the sweeps; without a pool every sweep runs on the calling thread
+    unique_ptr<ThreadPool> pool;
+
+    // row kernels for the sweeps, picked from cpuid in init()
+    const StencilKernels<Real>* kernels = &scalarStencilKernels<Real>();
+
+    // Streaming output: with a sink set, renderNext() hands each new frame, preceded by its
+    // in-betweens, to frameSink and keeps nothing but the previous frame
+    FrameSink<Real>* frameSink = nullptr;
+    FrameInterpolator<Real> frameInterpolator;
+
+    // Whole-run output: the frames collected by the caller. Their in-betweens are never
+    // stored; interpolatedFrame() blends one on request, and writeFramesToFile() records
+    // frameInterpolator.inBetweens so players blend them the same way.
+    vector <Velocity> frames;
 
     //core logic
     void forces();
     void diffusion();
     void projection();
     void advection();
-    void frameGen();
 
-    //file io
+    // frames with frameInterpolator.inBetweens blends between each pair
+    int interpolatedFrameCount() const;
+    void interpolatedFrame(int index, Velocity& out) const;
+
+    //file io of frames, in this grid's precision (see frame_io.hpp)
     void writeFramesToFile(const string& filename);
     void readFramesFromFile(const string& filename);
 
+    // Checkpoint/restart (checkpoint.hpp): copies out and back everything the next step depends
+    // on, so a restored grid continues bit for bit. restoreState() expects a grid initialised
+    // with state.config; with a frame sink the restored velocity becomes the previous frame,
+    // so the next frame's in-betweens continue the sequence.
+    void saveState(SolverState<Real>& state) const;
+    bool restoreState(const SolverState<Real>& state);
+
     //helper functions
     void renderNext();
-    void init();
-    Vec getBoundaryVelocity(int i, int j, const vector<vector<Vec>>& velocities);
-    double getBoundaryPressure(int i, int j, const vector<vector<double>> pressureForces);
+    void init(const SimulationConfig& config = SimulationConfig());
+    void setThreadCount(int threads);
+    void setSimdLevel(SimdLevel level);
+    double maxRowResidual();
+    double pressureResidual();
+
+    // Runs body(rowBegin, rowEnd) over all grid rows, split across the pool if there is one
+    template <typename Body>
+    void forEachRowBand(Body&& body) {
+        parallelRows(pool.get(), height, body);
+    }
 };
 
+using grid = BasicGrid<double>;
+using FloatGrid = BasicGrid<float>;
+
 #endif // GRID_HPP
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "interpolated_frames.hpp"
+#include "stencil_kernels.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+template <typename Real>
+void blendFrames(const unsigned char* from, const unsigned char* to, unsigned char* out, std::size_t count,
+                 int step, int period) {
+    const StencilKernels<Real>& kernels = stencilKernels<Real>(detectSimdLevel());
+    kernels.blendRow(reinterpret_cast<Real*>(out), reinterpret_cast<const Real*>(from), reinterpret_cast<const Real*>(to),
+                     static_cast<int>(count), Real(period - step), Real(step), Real(period));
+}
+
+}
+
+InterpolatedFrames::InterpolatedFrames(const MappedFrameFile& file, int inBetweens) : file(file) {
+    setInBetweens(inBetweens < 0 ? file.inBetweens() : inBetweens);
+}
+
+bool InterpolatedFrames::inRange(int index) const {
+    if (index >= 0 && index < frameCount()) return true;
+    std::cerr << "Error: played frame " << index << " is outside the file (" << frameCount() << " frames)" << std::endl;
+    return false;
+}
+
+void InterpolatedFrames::setInBetweens(int inBetweens) {
+    blends = std::max(0, inBetweens);
+}
+
+int InterpolatedFrames::frameCount() const {
+    return file.frameCount() == 0 ? 0 : playedFrame(file.frameCount() - 1) + 1;
+}
+
+double InterpolatedFrames::time(int index) const {
+    if (!inRange(index)) return 0;
+    int from = storedFrame(index);
+    int step = blendStep(index);
+    double fromTime = file.frameInfo(from).time;
+    if (step == 0) return fromTime;
+    return fromTime + (file.frameInfo(from + 1).time - fromTime) * step / (blends + 1);
+}
+
+// Copies stored frame index into whichever held frame is not the stored frame keep, unless
+// it is held already. Null when the file cannot give the frame.
+const unsigned char* InterpolatedFrames::stored(int index, int keep) {
+    for (Held& h : held) {
+        if (h.index == index) return reinterpret_cast<const unsigned char*>(h.values.data());
+    }
+    Held& h = held[0].index == keep ? held[1] : held[0];
+    std::size_t valueBytes = file.precision() == Precision::Float ? sizeof(float) : sizeof(double);
+    std::size_t bytes = 2 * static_cast<std::size_t>(file.width()) * file.height() * valueBytes;
+    FrameView view = file.frame(index);
+    if (view.data == nullptr) return nullptr;
+    h.values.resize((bytes + sizeof(double) - 1) / sizeof(double));
+    std::memcpy(h.values.data(), view.data, bytes);
+    h.index = index;
+    return reinterpret_cast<const unsigned char*>(h.values.data());
+}
+
+FrameView InterpolatedFrames::frame(int index) {
+    if (!inRange(index)) return FrameView();
+    int from = storedFrame(index);
+    int step = blendStep(index);
+    if (step == 0) {
+        return file.frame(from);
+    }
+
+    const unsigned char* fromValues = stored(from, from + 1);
+    const unsigned char* toValues = stored(from + 1, from);
+    if (fromValues == nullptr || toValues == nullptr) return FrameView();
+    std::size_t count = 2 * static_cast<std::size_t>(file.width()) * file.height();
+    blended.resize(count);
+    unsigned char* out = reinterpret_cast<unsigned char*>(blended.data());
+    if (file.precision() == Precision::Float) {
+        blendFrames<float>(fromValues, toValues, out, count, step, blends + 1);
+    }
+    else {
+        blendFrames<double>(fromValues, toValues, out, count, step, blends + 1);
+    }
+
+    FrameView view;
+    view.data = out;
+    view.width = file.width();
+    view.height = file.height();
+    view.precision = file.precision();
+    return view;
+}
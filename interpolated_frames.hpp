@@ -0,0 +1,56 @@
+#ifndef INTERPOLATED_FRAMES_HPP
+#define INTERPOLATED_FRAMES_HPP
+
+#include "mapped_frame_file.hpp"
+#include <vector>
+
+// Plays a frame file with in-betweens computed on request: frame index of the played sequence
+// is stored frame index / (inBetweens + 1), or a linear blend of the two stored frames around
+// it. Files therefore only need to hold the simulated frames, and the number of in-betweens can
+// change at any time during playback. Blends run through the SIMD blend kernel in the file's
+// precision and match what FrameInterpolator would have written, bit for bit.
+//
+// Only the two stored frames around the last request and one blend are held; playing forward,
+// each stored frame is read once. Views returned by frame() last until the next call, and like
+// its MappedFrameFile, one player must not be used from several threads.
+class InterpolatedFrames {
+public:
+    // Plays file with the in-betweens its header asks for, or inBetweens when that is not negative
+    explicit InterpolatedFrames(const MappedFrameFile& file, int inBetweens = -1);
+
+    void setInBetweens(int inBetweens);
+    int inBetweens() const { return blends; }
+
+    int frameCount() const;
+
+    // The stored frame at or before index, and how far index is past it, in blends
+    int storedFrame(int index) const { return index / (blends + 1); }
+    int blendStep(int index) const { return index % (blends + 1); }
+
+    // Played index of a stored frame
+    int playedFrame(int stored) const { return stored * (blends + 1); }
+
+    // Time of a played frame, evenly spaced between its stored frames' times; 0 for an index
+    // outside [0, frameCount()), which prints the problem
+    double time(int index) const;
+
+    // A stored frame comes straight from the file; an in-between is blended into a buffer. An
+    // index outside [0, frameCount()) prints the problem and gives a view with null data.
+    FrameView frame(int index);
+
+private:
+    struct Held {
+        int index = -1;
+        std::vector<double> values;     // the frame's interleaved values, float or double
+    };
+
+    const MappedFrameFile& file;
+    int blends = 0;
+    Held held[2];
+    std::vector<double> blended;
+
+    bool inRange(int index) const;
+    const unsigned char* stored(int index, int keep);
+};
+
+#endif // INTERPOLATED_FRAMES_HPP
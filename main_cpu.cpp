@@ -0,0 +1,258 @@
+#include "grid.hpp"
+#include "frame_pipeline.hpp"
+#include "frame_sink.hpp"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+// Headless CPU run for batch jobs: simulates a number of steps on a worker pool
+// and writes the interpolated frames for the visualizer. Each frame goes through a pipeline of
+// interpolation, encoding and I/O threads as soon as it is simulated, so the stages overlap
+// and memory does not grow with the run.
+// Usage: NavierStokesSolverCPU [steps] [threads] [output] [options]
+// Options are the SimulationConfig ones, e.g. --width 512 --height 512 --config run.cfg,
+// --multigrid | --multigrid-w | --cg | --cg-ic | --cg-mg, --cg-tol value --cg-max-iterations count,
+// --diffusion-tol value --projection-tol value --check-every sweeps, --precision float|double,
+// --temporal-block iterations --tile-rows rows,
+// --direct-io (O_DIRECT output), --sync none|close|buffer, --write-buffer-mb size,
+// --codec raw|lossless|quantized, --error-bound value (quantized), --keyframe-interval frames,
+// --frame-tile-size cells (tiled output for region reads),
+// --in-betweens count (blends per step that players compute; --eager-interpolation writes
+// them into the file instead),
+// --checkpoint path --checkpoint-every steps (written in the background, and at the end),
+// --restart path (continues a checkpointed run up to [steps] in total; its frames from the
+// restart on go to [output], and the checkpoint's config replaces the simulation options),
+// --pipeline-depth frames (in flight between stages), --no-pipeline (interpolate and encode
+// on the simulation thread)
+
+struct CheckpointOptions {
+    std::string path;
+    int every = 0;
+    std::string restartPath;
+};
+
+// pipelineDepth 0 runs every stage but the disk writes on the simulation thread
+struct PipelineOptions {
+    int depth = 4;
+};
+
+// The whole run in one precision; main() picks the instantiation from the config
+template <typename Real>
+int run(const SimulationConfig& config, int steps, int threads, const std::string& filename,
+        FrameWriter::Options output, int inBetweens, bool eagerInterpolation, const CheckpointOptions& checkpoints,
+        const PipelineOptions& pipelineOptions) {
+    BasicGrid<Real> g;
+    g.init(config);
+    g.setThreadCount(threads);
+    config.print(std::cout);
+    std::cout << "Threads: " << std::max(1, threads) << ", kernels: " << g.kernels->name;
+    if (g.kernels->width > 0) std::cout << " (specialised for width " << g.kernels->width << ")";
+    std::cout << std::endl;
+
+    // by default only the simulated frames are stored, and the file asks players for the blends
+    int eagerBlends = eagerInterpolation ? inBetweens : 0;
+    output.inBetweens = eagerInterpolation ? 0 : inBetweens;
+
+    FrameWriter writer;
+    if (!writer.open(filename, config.width, config.height, precisionOf<Real>(), output)) {
+        return 1;
+    }
+    // with the pipeline, the grid only hands over its frames and the blends happen downstream
+    FrameWriterSink<Real> sink(writer);
+    FramePipeline<Real> pipeline;
+    if (pipelineOptions.depth > 0) {
+        typename FramePipeline<Real>::Options stages;
+        stages.queueDepth = pipelineOptions.depth;
+        stages.inBetweens = eagerBlends;
+        pipeline.start(writer, config.height, config.width, stages);
+        g.frameInterpolator.inBetweens = 0;
+        g.frameSink = &pipeline;
+    }
+    else {
+        g.frameInterpolator.inBetweens = eagerBlends;
+        g.frameSink = &sink;
+    }
+
+    if (!checkpoints.restartPath.empty()) {
+        auto restoreStart = std::chrono::steady_clock::now();
+        SolverState<Real> state;
+        if (!readCheckpoint(checkpoints.restartPath, state) || !g.restoreState(state)) {
+            return 1;
+        }
+        if (pipelineOptions.depth > 0) {
+            pipeline.seed(g.currentVelocities, g.time);
+        }
+        std::cout << "Restarted from " << checkpoints.restartPath << " at step " << g.stepCount << " in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - restoreStart).count()
+                  << " s" << std::endl;
+    }
+
+    CheckpointWriter<Real> checkpointWriter;
+    bool checkpointDue = false;
+
+    long diffusionSweeps = 0;
+    long pressureIterations = 0;
+    long firstStep = g.stepCount;
+    auto start = std::chrono::steady_clock::now();
+    while (g.stepCount < steps) {
+        g.renderNext();
+        diffusionSweeps += g.lastDiffusionSolve.iterations;
+        pressureIterations += g.lastPressureSolve.iterations;
+
+        if (checkpoints.every > 0 && g.stepCount % checkpoints.every == 0) {
+            checkpointDue = true;
+        }
+        // the step loop only copies the state; while the last checkpoint is still being
+        // written, this one waits for a later step rather than stalling the loop
+        if (checkpointDue && !checkpointWriter.busy()) {
+            g.saveState(checkpointWriter.snapshot());
+            checkpointWriter.write(checkpoints.path);
+            checkpointDue = false;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long simulated = g.stepCount - firstStep;
+    std::cout << "Simulated " << simulated << " steps in " << elapsed << " s" << std::endl;
+    if (pipelineOptions.depth > 0) {
+        // the run ends when the last frame is written, not when the last step is simulated
+        pipeline.finish();
+        std::cout << "Output drained " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - elapsed
+                  << " s after the last step" << std::endl;
+    }
+    if (simulated > 0) {
+        std::cout << "Iterations per step: diffusion " << double(diffusionSweeps) / simulated
+                  << ", pressure " << double(pressureIterations) / simulated << std::endl;
+    }
+
+    bool ok = writer.close();
+    if (pipelineOptions.depth > 0) {
+        pipeline.printStats(std::cout);
+    }
+    if (!checkpoints.path.empty()) {
+        g.saveState(checkpointWriter.snapshot());
+        checkpointWriter.write(checkpoints.path);
+        ok = checkpointWriter.finish() && ok;
+        std::cout << "Checkpoints written: " << checkpointWriter.checkpointsWritten() << ", last in "
+                  << checkpointWriter.lastWriteSeconds() << " s" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    int steps = 100;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    std::string filename = "finalframes.txt";
+    FrameWriter::Options output;
+    CheckpointOptions checkpoints;
+    PipelineOptions pipelineOptions;
+    int inBetweens = 10;
+    bool eagerInterpolation = false;
+
+    // reports a value that does not parse the way SimulationConfig::set does
+    auto intValue = [](const std::string& option, const std::string& text, int& value) {
+        if (parseInt(text, value)) return true;
+        std::cerr << "Invalid value for " << option << ": " << text << std::endl;
+        return false;
+    };
+
+    // output options are this tool's own; everything else goes to SimulationConfig
+    std::vector<char*> simulationArgs;
+    for (int a = 0; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg == "--direct-io") {
+            output.directIO = true;
+        }
+        else if (arg == "--eager-interpolation") {
+            eagerInterpolation = true;
+        }
+        else if (arg == "--no-pipeline") {
+            pipelineOptions.depth = 0;
+        }
+        else if (arg == "--pipeline-depth" && a + 1 < argc) {
+            if (!intValue(arg, argv[++a], pipelineOptions.depth)) return 1;
+            pipelineOptions.depth = std::max(1, pipelineOptions.depth);
+        }
+        else if (arg == "--in-betweens" && a + 1 < argc) {
+            if (!intValue(arg, argv[++a], inBetweens)) return 1;
+            inBetweens = std::max(0, inBetweens);
+        }
+        else if ((arg == "--checkpoint" || arg == "--checkpoint-every" || arg == "--restart") && a + 1 < argc) {
+            std::string value = argv[++a];
+            if (arg == "--checkpoint") checkpoints.path = value;
+            else if (arg == "--restart") checkpoints.restartPath = value;
+            else {
+                if (!intValue(arg, value, checkpoints.every)) return 1;
+                checkpoints.every = std::max(0, checkpoints.every);
+            }
+        }
+        else if ((arg == "--sync" || arg == "--write-buffer-mb" || arg == "--codec" || arg == "--error-bound" ||
+                  arg == "--keyframe-interval" || arg == "--frame-tile-size") && a + 1 < argc) {
+            std::string value = argv[++a];
+            if (arg == "--write-buffer-mb") {
+                int megabytes = 0;
+                if (!intValue(arg, value, megabytes)) return 1;
+                output.bufferBytes = static_cast<std::size_t>(std::max(1, megabytes)) << 20;
+            }
+            else if (arg == "--error-bound") {
+                if (!parseDouble(value, output.errorBound)) {
+                    std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--keyframe-interval") {
+                if (!intValue(arg, value, output.keyframeInterval)) return 1;
+            }
+            else if (arg == "--frame-tile-size") {
+                if (!intValue(arg, value, output.tileSize)) return 1;
+            }
+            else if (arg == "--codec") {
+                if (value == "raw") output.codec = FrameCodec::Raw;
+                else if (value == "lossless") output.codec = FrameCodec::Lossless;
+                else if (value == "quantized") output.codec = FrameCodec::Quantized;
+                else {
+                    std::cerr << "Invalid value for --codec: " << value << std::endl;
+                    return 1;
+                }
+            }
+            else if (value == "none") output.sync = SyncPolicy::None;
+            else if (value == "close") output.sync = SyncPolicy::AtClose;
+            else if (value == "buffer") output.sync = SyncPolicy::EveryBuffer;
+            else {
+                std::cerr << "Invalid value for --sync: " << value << std::endl;
+                return 1;
+            }
+        }
+        else {
+            simulationArgs.push_back(argv[a]);
+        }
+    }
+
+    SimulationConfig config;
+    std::vector<std::string> positional;
+    if (!config.parseArguments(static_cast<int>(simulationArgs.size()), simulationArgs.data(), positional) ||
+        !config.validate()) {
+        return 1;
+    }
+    if (positional.size() > 0 && !intValue("steps", positional[0], steps)) return 1;
+    if (positional.size() > 1 && !intValue("threads", positional[1], threads)) return 1;
+    if (positional.size() > 2) filename = positional[2];
+
+    if (checkpoints.every > 0 && checkpoints.path.empty()) {
+        std::cerr << "--checkpoint-every needs --checkpoint path" << std::endl;
+        return 1;
+    }
+    // a restarted run continues with the config it was checkpointed with
+    if (!checkpoints.restartPath.empty() && !readCheckpointConfig(checkpoints.restartPath, config)) {
+        return 1;
+    }
+
+    if (config.precision == Precision::Float) {
+        return run<float>(config, steps, threads, filename, output, inBetweens, eagerInterpolation, checkpoints,
+                          pipelineOptions);
+    }
+    return run<double>(config, steps, threads, filename, output, inBetweens, eagerInterpolation, checkpoints,
+                       pipelineOptions);
+}
@@ -1,8 +1,12 @@
 #include "gpu_solver.hpp"
 #include "grid.hpp"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <chrono>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <iomanip>
 #include <ctime>
 
@@ -22,7 +26,59 @@ std::string formatFPS(float fps) {
     return ss.str();
 }
 
-int main() {
+// Parses a scripted splat, "x,y,fx,fy[,radius[,strength]]" with the centre in grid cells
+bool parseSplat(const std::string& text, ForceSplat& splat) {
+    std::vector<double> values;
+    std::stringstream in(text);
+    std::string field;
+    while (std::getline(in, field, ',')) {
+        double value;
+        if (!parseDouble(field, value)) return false;
+        values.push_back(value);
+    }
+    if (values.size() < 4 || values.size() > 6) return false;
+
+    splat = ForceSplat();
+    splat.x = static_cast<float>(values[0]);
+    splat.y = static_cast<float>(values[1]);
+    splat.fx = static_cast<float>(values[2]);
+    splat.fy = static_cast<float>(values[3]);
+    if (values.size() > 4) splat.radius = static_cast<float>(values[4]);
+    if (values.size() > 5) splat.strength = static_cast<float>(values[5]);
+    return splat.radius > 0;
+}
+
+// How solver steps are spread over displayed frames. Fixed runs stepsPerFrame steps before
+// each frame, so rendering only every k-th step is stepsPerFrame = k. RealTime adds each
+// frame's wall time, times rate, to an accumulator and runs one step per timeStep of it, so
+// the simulation keeps its pace whether the solver is faster than the display (some frames
+// get no step) or slower (several steps per frame). A solver that cannot keep up runs at
+// most maxStepsPerFrame and drops the rest, rather than falling ever further behind.
+struct StepSchedule {
+    enum class Mode { Fixed, RealTime };
+    Mode mode = Mode::Fixed;
+    int stepsPerFrame = 1;
+    double rate = 1;              // simulated time per second of wall time
+    int maxStepsPerFrame = 8;
+    double accumulator = 0;
+    double droppedTime = 0;       // simulated time skipped because the solver fell behind
+
+    int stepsFor(double frameSeconds, double timeStep) {
+        if (mode == Mode::Fixed) return stepsPerFrame;
+        accumulator += frameSeconds * rate;
+        int due = static_cast<int>(accumulator / timeStep);
+        int run = std::min(due, maxStepsPerFrame);
+        accumulator -= run * timeStep;
+        if (due > run) {
+            // keep the fraction towards the next step, drop whole steps
+            droppedTime += (due - run) * timeStep;
+            accumulator -= (due - run) * timeStep;
+        }
+        return run;
+    }
+};
+
+int main(int argc, char** argv) {
     try {
         // Print initialization information
         std::cout << "Navier-Stokes GPU Solver" << std::endl;
@@ -30,93 +86,379 @@ int main() {
         std::cout << "User: " << "SamarthGupta23" << std::endl;
         std::cout << std::string(50, '-') << std::endl;
 
-        // Grid dimensions
-        const int gridWidth = 512;
-        const int gridHeight = 512;
+        // Checkpoints: --checkpoint path --checkpoint-every steps writes the state in the
+        // background (and once more on exit); --restart path continues a checkpointed run
+        // with the config it was saved with.
+        // Batch runs: --headless needs no display and runs --steps N (in total, counting the
+        // steps before a restart) as fast as the device allows, e.g. on Mesa's llvmpipe with
+        // LIBGL_ALWAYS_SOFTWARE=1. --steps also ends a windowed run.
+        // Scripted forcing, so batch runs have something to simulate: each --splat
+        // x,y,fx,fy[,radius[,strength]] is added before the first step, and again every
+        // --splat-every N steps. It follows the step count, so a restarted run gets the same
+        // forcing as one that never stopped.
+        std::string checkpointPath, restartPath;
+        int checkpointEvery = 0;
+        // Pacing of the windowed loop: --steps-per-frame N (fixed, default 1), or --realtime
+        // [rate] for accumulator pacing at rate simulated time units per second, with at most
+        // --max-steps-per-frame steps before a frame
+        // --stats-every N prints field statistics every N steps, reduced on the GPU and read
+        // back without stalling the loop
+        bool headless = false;
+        long steps = 0;
+        int statsEvery = 0;
+        StepSchedule schedule;
+        std::vector<ForceSplat> splats;
+        int splatEvery = 0;
+        // reports a value that does not parse the way SimulationConfig::set does
+        auto intValue = [](const std::string& option, const std::string& text, int& value) {
+            if (parseInt(text, value)) return true;
+            std::cerr << "Invalid value for " << option << ": " << text << std::endl;
+            return false;
+        };
+        std::vector<char*> simulationArgs;
+        for (int a = 0; a < argc; a++) {
+            std::string arg = argv[a];
+            if (arg == "--headless") {
+                headless = true;
+            }
+            else if (arg == "--steps" && a + 1 < argc) {
+                int count = 0;
+                if (!intValue(arg, argv[++a], count)) return 1;
+                steps = std::max(0, count);
+            }
+            else if (arg == "--steps-per-frame" && a + 1 < argc) {
+                schedule.mode = StepSchedule::Mode::Fixed;
+                if (!intValue(arg, argv[++a], schedule.stepsPerFrame)) return 1;
+                schedule.stepsPerFrame = std::max(1, schedule.stepsPerFrame);
+            }
+            else if (arg == "--splat" && a + 1 < argc) {
+                ForceSplat splat;
+                if (!parseSplat(argv[++a], splat)) {
+                    std::cerr << "Invalid value for --splat: " << argv[a] << " (expected x,y,fx,fy[,radius[,strength]])"
+                              << std::endl;
+                    return 1;
+                }
+                splats.push_back(splat);
+            }
+            else if (arg == "--splat-every" && a + 1 < argc) {
+                if (!intValue(arg, argv[++a], splatEvery)) return 1;
+                splatEvery = std::max(0, splatEvery);
+            }
+            else if (arg == "--stats-every" && a + 1 < argc) {
+                if (!intValue(arg, argv[++a], statsEvery)) return 1;
+                statsEvery = std::max(0, statsEvery);
+            }
+            else if (arg == "--max-steps-per-frame" && a + 1 < argc) {
+                if (!intValue(arg, argv[++a], schedule.maxStepsPerFrame)) return 1;
+                schedule.maxStepsPerFrame = std::max(1, schedule.maxStepsPerFrame);
+            }
+            else if (arg == "--realtime") {
+                schedule.mode = StepSchedule::Mode::RealTime;
+                // the rate is optional
+                if (a + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[a + 1][0]))) {
+                    if (!parseDouble(argv[++a], schedule.rate)) {
+                        std::cerr << "Invalid value for --realtime: " << argv[a] << std::endl;
+                        return 1;
+                    }
+                }
+            }
+            else if ((arg == "--checkpoint" || arg == "--checkpoint-every" || arg == "--restart") && a + 1 < argc) {
+                std::string value = argv[++a];
+                if (arg == "--checkpoint") checkpointPath = value;
+                else if (arg == "--restart") restartPath = value;
+                else {
+                    if (!intValue(arg, value, checkpointEvery)) return 1;
+                    checkpointEvery = std::max(0, checkpointEvery);
+                }
+            }
+            else {
+                simulationArgs.push_back(argv[a]);
+            }
+        }
+        if (checkpointEvery > 0 && checkpointPath.empty()) {
+            std::cerr << "--checkpoint-every needs --checkpoint path" << std::endl;
+            return 1;
+        }
+        if (headless && steps == 0) {
+            std::cerr << "--headless needs --steps N" << std::endl;
+            return 1;
+        }
+        if (headless && splats.empty() && restartPath.empty()) {
+            std::cout << "Note: no --splat or --restart, so the field stays at rest" << std::endl;
+        }
+
+        // Grid size and solver settings: the GPU defaults, overridden by SimulationConfig
+        // options (--width 1024, --config run.cfg, --multigrid, --pressure-tol 1e-4, ...)
+        SimulationConfig config = SimulationConfig::gpuDefaults();
+        std::vector<std::string> positional;
+        if (!config.parseArguments(static_cast<int>(simulationArgs.size()), simulationArgs.data(), positional) ||
+            !config.validate()) {
+            return 1;
+        }
+        SolverState<float> restartState;
+        if (!restartPath.empty()) {
+            if (!readCheckpoint(restartPath, restartState)) {
+                return 1;
+            }
+            config = restartState.config;
+        }
+        if (config.pressureSolver == PressureSolver::ConjugateGradient) {
+            std::cout << "Conjugate gradient is CPU-only; using Gauss-Seidel" << std::endl;
+            config.pressureSolver = PressureSolver::GaussSeidel;
+        }
+        const int gridWidth = config.width;
+        const int gridHeight = config.height;
 
         std::cout << "Configuration:" << std::endl;
-        std::cout << "Grid Size: " << gridWidth << "x" << gridHeight << std::endl;
+        config.print(std::cout);
 
         // Initialize GPU solver
         std::cout << "Initializing GPU solver..." << std::endl;
-        GPUSolver gpuSolver(gridWidth, gridHeight);
-        if (!gpuSolver.initialize()) {
+        GPUSolver gpuSolver(config);
+        if (!gpuSolver.initialize(headless)) {
             std::cerr << "Failed to initialize GPU solver" << std::endl;
             return 1;
         }
+        if (!restartPath.empty()) {
+            if (!gpuSolver.restoreCheckpoint(restartState)) {
+                return 1;
+            }
+            std::cout << "Restarted from " << restartPath << " at step " << gpuSolver.getStepCount() << std::endl;
+        }
+
+        CheckpointWriter<float> checkpointWriter;
+        bool checkpointDue = false;
+        // Waits for the readback in flight, if any; only used on exit
+        auto awaitCheckpoint = [&](SolverState<float>& state) {
+            while (gpuSolver.checkpointPending()) {
+                if (gpuSolver.pollCheckpoint(state)) return true;
+            }
+            return false;
+        };
+        long diffusionSweeps = 0, pressureSweeps = 0;
+
+        // Field statistics of one step, queued on the GPU and printed once all have landed; the
+        // next sample waits until then
+        struct StatsSample {
+            bool pending = false;
+            long step = 0;
+            std::uint64_t maxSpeed, speedNorm, rhsNorm, pressureRange;
+        } stats;
+        auto collectStats = [&]() {
+            GPUReduction& reduction = gpuSolver.getReduction();
+            GPUReduction::Result maxSpeed, speedNorm, rhsNorm, pressureRange;
+            if (!reduction.poll(stats.maxSpeed, maxSpeed)) return;
+            reduction.wait(stats.speedNorm, speedNorm);
+            reduction.wait(stats.rhsNorm, rhsNorm);
+            reduction.wait(stats.pressureRange, pressureRange);
+            stats.pending = false;
+
+            // kinetic energy per unit density: half the sum of speed squared over the cell areas
+            double kineticEnergy = 0.5 * double(speedNorm.value) * speedNorm.value * config.dx * config.dx;
+            std::cout << "Step " << stats.step << ": max speed " << maxSpeed.value
+                      << " (CFL " << maxSpeed.value * config.timeStep / config.dx << ")"
+                      << ", kinetic energy " << kineticEnergy
+                      << ", pressure RHS L2 " << rhsNorm.value
+                      << ", pressure [" << pressureRange.min << ", " << pressureRange.max << "]" << std::endl;
+        };
+
+        // One solver step, with the checkpoint bookkeeping that follows it. The readback is
+        // queued behind the step and collected on a later one, once the GPU has finished it;
+        // while the last checkpoint is still being written to disk, the next one waits rather
+        // than stalling the loop.
+        auto simulateStep = [&]() {
+            long done = gpuSolver.getStepCount();
+            if (done == 0 || (splatEvery > 0 && done % splatEvery == 0)) {
+                for (const ForceSplat& splat : splats) {
+                    gpuSolver.addSplat(splat);
+                }
+            }
+            gpuSolver.step();
+            diffusionSweeps += gpuSolver.getLastDiffusionSolve().iterations;
+            pressureSweeps += gpuSolver.getLastPressureSolve().iterations;
+
+            if (checkpointEvery > 0 && gpuSolver.getStepCount() % checkpointEvery == 0) {
+                checkpointDue = true;
+            }
+            if (checkpointDue && !checkpointWriter.busy() && gpuSolver.requestCheckpoint()) {
+                checkpointDue = false;
+            }
+            if (!checkpointWriter.busy() && gpuSolver.checkpointPending() &&
+                gpuSolver.pollCheckpoint(checkpointWriter.snapshot())) {
+                checkpointWriter.write(checkpointPath);
+            }
+
+            if (stats.pending) {
+                collectStats();
+            }
+            if (statsEvery > 0 && gpuSolver.getStepCount() % statsEvery == 0 && !stats.pending) {
+                stats.pending = true;
+                stats.step = gpuSolver.getStepCount();
+                stats.maxSpeed = gpuSolver.reduceField(GPUSolver::Field::Velocity, GPUReduction::Op::Max);
+                stats.speedNorm = gpuSolver.reduceField(GPUSolver::Field::Velocity, GPUReduction::Op::L2Norm);
+                stats.rhsNorm = gpuSolver.reduceField(GPUSolver::Field::PressureRhs, GPUReduction::Op::L2Norm);
+                stats.pressureRange = gpuSolver.reduceField(GPUSolver::Field::Pressure, GPUReduction::Op::MinMax);
+            }
+        };
 
         // Initialize timing variables
         auto lastTime = std::chrono::high_resolution_clock::now();
         auto lastFPSUpdate = lastTime;
         int frameCount = 0;
         float currentFPS = 0.0f;
+        long stepsSinceUpdate = 0;
+        double simulateSeconds = 0, presentSeconds = 0;
+        double totalSimulateSeconds = 0, totalPresentSeconds = 0;
+        long totalFrames = 0;
 
-        std::cout << "\nSimulation Controls:" << std::endl;
-        std::cout << "- ESC: Exit simulation" << std::endl;
-        std::cout << "- Left Mouse Button: Add forces" << std::endl;
-        std::cout << "\nStarting simulation loop..." << std::endl;
-        std::cout << std::string(50, '-') << std::endl;
+        if (headless) {
+            // Nothing is presented, so the only pacing is the GPU itself; finish() makes the
+            // time cover the work and not just its submission
+            long firstStep = gpuSolver.getStepCount();
+            auto start = std::chrono::steady_clock::now();
+            while (gpuSolver.getStepCount() < steps) {
+                simulateStep();
+            }
+            gpuSolver.finish();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            long simulated = gpuSolver.getStepCount() - firstStep;
+            std::cout << "Simulated " << simulated << " steps in " << seconds << " s";
+            if (simulated > 0 && seconds > 0) {
+                std::cout << " (" << simulated / seconds << " steps/s, " << 1000 * seconds / simulated << " ms/step)"
+                          << std::endl;
+                std::cout << "Iterations per step: diffusion " << double(diffusionSweeps) / simulated
+                          << ", pressure " << double(pressureSweeps) / simulated;
+            }
+            std::cout << std::endl;
+        }
+        else {
+            std::cout << "\nSimulation Controls:" << std::endl;
+            std::cout << "- ESC: Exit simulation" << std::endl;
+            std::cout << "- Left Mouse Button: Add forces" << std::endl;
+            if (schedule.mode == StepSchedule::Mode::Fixed) {
+                std::cout << "Pacing: " << schedule.stepsPerFrame << " step(s) per frame" << std::endl;
+            }
+            else {
+                std::cout << "Pacing: real time x" << schedule.rate << ", at most " << schedule.maxStepsPerFrame
+                          << " steps per frame" << std::endl;
+            }
+            std::cout << "\nStarting simulation loop..." << std::endl;
+            std::cout << std::string(50, '-') << std::endl;
 
-        // Main simulation loop
-        while (!gpuSolver.shouldClose()) {
-            // Timing
-            auto currentTime = std::chrono::high_resolution_clock::now();
-            float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
-            lastTime = currentTime;
+            // Main simulation loop
+            while (!gpuSolver.shouldClose()) {
+                // Timing
+                auto currentTime = std::chrono::high_resolution_clock::now();
+                float deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
+                lastTime = currentTime;
 
-            // Handle input
-            gpuSolver.pollEvents();
+                // Handle input
+                gpuSolver.pollEvents();
 
-            // Check for ESC key
-            if (glfwGetKey(gpuSolver.getWindow(), GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-                break;
-            }
+                // Check for ESC key
+                if (glfwGetKey(gpuSolver.getWindow(), GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                    break;
+                }
 
-            // Handle mouse input for force injection
-            static bool mousePressed = false;
-            static double lastMouseX = 0, lastMouseY = 0;
+                // Handle mouse input for force injection
+                static bool mousePressed = false;
+                static double lastMouseX = 0, lastMouseY = 0;
 
-            double mouseX, mouseY;
-            glfwGetCursorPos(gpuSolver.getWindow(), &mouseX, &mouseY);
+                double mouseX, mouseY;
+                glfwGetCursorPos(gpuSolver.getWindow(), &mouseX, &mouseY);
 
-            // Convert screen coordinates to grid coordinates
-            int gridX = static_cast<int>((mouseX / gpuSolver.getWindowWidth()) * gridWidth);
-            int gridY = static_cast<int>((mouseY / gpuSolver.getWindowHeight()) * gridHeight);
+                // Convert screen coordinates to grid coordinates
+                int gridX = static_cast<int>((mouseX / gpuSolver.getWindowWidth()) * gridWidth);
+                int gridY = static_cast<int>((mouseY / gpuSolver.getWindowHeight()) * gridHeight);
 
-            if (glfwGetMouseButton(gpuSolver.getWindow(), GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
-                if (mousePressed) {
-                    // Calculate force based on mouse movement
-                    float forceX = static_cast<float>(mouseX - lastMouseX) * 0.001f;
-                    float forceY = static_cast<float>(mouseY - lastMouseY) * 0.001f;
-                    gpuSolver.addForce(gridX, gridY, forceX, forceY);
+                if (glfwGetMouseButton(gpuSolver.getWindow(), GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+                    if (mousePressed) {
+                        // Calculate force based on mouse movement
+                        float forceX = static_cast<float>(mouseX - lastMouseX) * 0.001f;
+                        float forceY = static_cast<float>(mouseY - lastMouseY) * 0.001f;
+                        gpuSolver.addForce(gridX, gridY, forceX, forceY);
+                    }
+                    mousePressed = true;
+                } else {
+                    mousePressed = false;
                 }
-                mousePressed = true;
-            } else {
-                mousePressed = false;
-            }
 
-            lastMouseX = mouseX;
-            lastMouseY = mouseY;
+                lastMouseX = mouseX;
+                lastMouseY = mouseY;
 
-            // Run simulation steps
-            gpuSolver.applyForces();
-            gpuSolver.diffuse();
-            gpuSolver.advect();
-            gpuSolver.project();
+                // Run simulation steps. finish() makes the simulation time cover the GPU work
+                // and not only its submission, so it is not charged to the frame that follows.
+                auto simulateStart = std::chrono::high_resolution_clock::now();
+                int due = schedule.stepsFor(deltaTime, config.timeStep);
+                bool done = false;
+                for (int s = 0; s < due && !done; s++) {
+                    simulateStep();
+                    stepsSinceUpdate++;
+                    done = steps > 0 && gpuSolver.getStepCount() >= steps;
+                }
+                if (due > 0) gpuSolver.finish();
+                auto presentStart = std::chrono::high_resolution_clock::now();
+                simulateSeconds += std::chrono::duration<double>(presentStart - simulateStart).count();
+                if (done) {
+                    break;
+                }
 
-            // Render
-            gpuSolver.render();
+                // Render
+                gpuSolver.render();
+                presentSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - presentStart).count();
 
-            // FPS calculation and display
-            frameCount++;
-            auto timeSinceLastFPSUpdate = std::chrono::duration<float>(currentTime - lastFPSUpdate).count();
+                // FPS calculation and display
+                frameCount++;
+                auto timeSinceLastFPSUpdate = std::chrono::duration<float>(currentTime - lastFPSUpdate).count();
 
-            if (timeSinceLastFPSUpdate >= 1.0f) {  // Update FPS every second
-                currentFPS = frameCount / timeSinceLastFPSUpdate;
-                std::cout << "FPS: " << formatFPS(currentFPS) << std::endl;
+                if (timeSinceLastFPSUpdate >= 1.0f) {  // Update FPS every second
+                    currentFPS = frameCount / timeSinceLastFPSUpdate;
+                    std::cout << "FPS: " << formatFPS(currentFPS)
+                              << "  steps/s: " << formatFPS(stepsSinceUpdate / timeSinceLastFPSUpdate)
+                              << "  ms/frame: simulate " << 1000 * simulateSeconds / frameCount
+                              << ", present " << 1000 * presentSeconds / frameCount;
+                    if (stepsSinceUpdate > 0) {
+                        std::cout << "  iterations/step: diffusion " << double(diffusionSweeps) / stepsSinceUpdate
+                                  << ", pressure " << double(pressureSweeps) / stepsSinceUpdate;
+                    }
+                    std::cout << std::endl;
 
-                frameCount = 0;
-                lastFPSUpdate = currentTime;
+                    totalSimulateSeconds += simulateSeconds;
+                    totalPresentSeconds += presentSeconds;
+                    totalFrames += frameCount;
+                    frameCount = 0;
+                    stepsSinceUpdate = 0;
+                    simulateSeconds = presentSeconds = 0;
+                    diffusionSweeps = pressureSweeps = 0;
+                    lastFPSUpdate = currentTime;
+                }
+            }
+
+            totalSimulateSeconds += simulateSeconds;
+            totalPresentSeconds += presentSeconds;
+            totalFrames += frameCount;
+            std::cout << "Wall time: simulate " << totalSimulateSeconds << " s, present " << totalPresentSeconds
+                      << " s over " << totalFrames << " frames" << std::endl;
+            if (schedule.droppedTime > 0) {
+                std::cout << "Real-time pacing dropped " << schedule.droppedTime
+                          << " simulated time units the solver could not keep up with" << std::endl;
+            }
+        }
+
+        if (stats.pending) {
+            gpuSolver.finish();
+            collectStats();
+        }
+
+        if (!checkpointPath.empty()) {
+            SolverState<float>& state = checkpointWriter.snapshot();
+            awaitCheckpoint(state);
+            bool saved = gpuSolver.requestCheckpoint() && awaitCheckpoint(state);
+            if (saved) {
+                checkpointWriter.write(checkpointPath);
+            }
+            if (checkpointWriter.finish() && saved) {
+                std::cout << "Checkpoint at step " << gpuSolver.getStepCount() << " written to " << checkpointPath << std::endl;
             }
         }
 
@@ -1,4 +1,5 @@
 #include "raylib_visualizer.hpp"
+#include "simulation_config.hpp"
 #include <iostream>
 
 int main(int argc, char** argv) {
@@ -6,6 +7,15 @@ int main(int argc, char** argv) {
     if (argc > 1) filename = argv[1];
 
     RaylibVisualizer viz(800, 800);
+    // in-betweens played between stored frames; by default the file's own
+    if (argc > 2) {
+        int inBetweens = 0;
+        if (!parseInt(argv[2], inBetweens)) {
+            std::cerr << "Invalid value for in-betweens: " << argv[2] << std::endl;
+            return 1;
+        }
+        viz.setInBetweens(inBetweens);
+    }
     if (!viz.initialize()) return 1;
 
     if (!viz.loadFramesFromFile(filename)) {
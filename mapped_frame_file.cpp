@@ -0,0 +1,361 @@
+#include "mapped_frame_file.hpp"
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Splits count stored (vx, vy) cells into u and v
+template <typename Real>
+void copyCells(const unsigned char* stored, Real* u, Real* v, int count, Precision precision) {
+    for (int j = 0; j < count; j++) {
+        if (precision == Precision::Float) {
+            float cell[2];
+            std::memcpy(cell, stored + 2 * j * sizeof(float), sizeof(cell));
+            u[j] = Real(cell[0]);
+            v[j] = Real(cell[1]);
+        }
+        else {
+            double cell[2];
+            std::memcpy(cell, stored + 2 * j * sizeof(double), sizeof(cell));
+            u[j] = Real(cell[0]);
+            v[j] = Real(cell[1]);
+        }
+    }
+}
+
+}
+
+MappedFrameFile::~MappedFrameFile() {
+    close();
+}
+
+bool MappedFrameFile::open(const std::string& filename) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error: Could not open file " << filename << " for reading" << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+    HANDLE view = size > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    mapping = view ? static_cast<const unsigned char*>(MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    fileHandle = file;
+    mappingHandle = view;
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file " << filename << " for reading" << std::endl;
+        return false;
+    }
+    struct stat info;
+    size = (fstat(fd, &info) == 0) ? static_cast<std::size_t>(info.st_size) : 0;
+    void* view = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);    // the mapping keeps the file alive
+    if (view != MAP_FAILED) {
+        mapping = static_cast<const unsigned char*>(view);
+        // frames are mostly played or scanned front to back
+        madvise(view, size, MADV_SEQUENTIAL);
+    }
+#endif
+
+    if (!mapping) {
+        std::cerr << "Error: Could not map " << filename << (size == 0 ? " (empty file)" : "") << std::endl;
+        close();
+        return false;
+    }
+
+    if (!parseFrameFileHeader(mapping, size, header)) {
+        close();
+        return false;
+    }
+    if (!header.chunked()) {
+        std::size_t available = (size - header.dataOffset) / header.frameBytes();
+        if (static_cast<std::size_t>(header.numFrames) > available) {
+            std::cerr << "Error: " << filename << " declares " << header.numFrames << " frames but holds "
+                      << available << std::endl;
+            close();
+            return false;
+        }
+        // fixed-size frames: the index is arithmetic
+        builtIndex.resize(header.numFrames);
+        for (int f = 0; f < header.numFrames; f++) {
+            builtIndex[f].offset = header.dataOffset + static_cast<std::size_t>(f) * header.frameBytes();
+            builtIndex[f].payloadBytes = header.frameBytes();
+            builtIndex[f].time = f;
+        }
+        entries = builtIndex.data();
+        return true;
+    }
+
+    if (!useFooterIndex(filename) && !walkFrames(filename)) {
+        close();
+        return false;
+    }
+    if (header.codec != FrameCodec::Raw || header.tiled()) {
+        decoded.resize(header.frameBytes() / sizeof(double) + 1);
+        floatDecoder = FrameDecoder<float>(header.codec, header.errorBound);
+        doubleDecoder = FrameDecoder<double>(header.codec, header.errorBound);
+    }
+    if (header.tiled()) {
+        Tile tile;
+        tile.floatDecoder = floatDecoder;
+        tile.doubleDecoder = doubleDecoder;
+        tile.values.resize(static_cast<std::size_t>(header.tileSize) * header.tileSize * 2 * header.bytesPerValue() / sizeof(double) + 1);
+        tiles.assign(header.tileCount(), tile);
+    }
+    return true;
+}
+
+void MappedFrameFile::close() {
+#ifdef _WIN32
+    if (mapping) UnmapViewOfFile(mapping);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+#else
+    if (mapping) munmap(const_cast<unsigned char*>(mapping), size);
+#endif
+    mapping = nullptr;
+    size = 0;
+    header = FrameFileHeader();
+    entries = nullptr;
+    builtIndex.clear();
+    decoded.clear();
+    tiles.clear();
+    decodedIndex = -1;
+}
+
+bool MappedFrameFile::useFooterIndex(const std::string& filename) {
+    std::uint64_t offset = header.indexOffset;
+    std::uint64_t footerBytes = sizeof(FRAME_INDEX_MAGIC) + sizeof(std::uint32_t);
+    if (offset == 0) {
+        std::cerr << filename << " has no frame index (the writer did not finish); scanning frames" << std::endl;
+        return false;
+    }
+
+    std::uint32_t count = 0;
+    bool ok = offset % alignof(FrameIndexEntry) == 0 && offset >= header.dataOffset && offset <= size &&
+              size - offset >= footerBytes &&
+              std::memcmp(mapping + offset, FRAME_INDEX_MAGIC, sizeof(FRAME_INDEX_MAGIC)) == 0;
+    if (ok) {
+        std::memcpy(&count, mapping + offset + sizeof(FRAME_INDEX_MAGIC), sizeof(count));
+        ok = count == static_cast<std::uint32_t>(header.numFrames) &&
+             (size - offset - footerBytes) / sizeof(FrameIndexEntry) >= count;
+    }
+    // the mapping is page aligned, so the entries can be used in place
+    const FrameIndexEntry* footer = reinterpret_cast<const FrameIndexEntry*>(mapping + offset + footerBytes);
+    for (std::uint32_t f = 0; ok && f < count; f++) {
+        const FrameIndexEntry& entry = footer[f];
+        ok = entry.offset >= header.dataOffset && entry.offset <= offset && entry.payloadBytes <= offset - entry.offset &&
+             (header.codec != FrameCodec::Raw || header.tiled() || entry.payloadBytes == header.frameBytes());
+    }
+    if (!ok) {
+        std::cerr << "The frame index of " << filename << " is invalid; scanning frames" << std::endl;
+        return false;
+    }
+    entries = footer;
+    return true;
+}
+
+// Finds the frames from their size words, for files without a usable index
+bool MappedFrameFile::walkFrames(const std::string& filename) {
+    builtIndex.resize(header.numFrames);
+    std::size_t offset = header.dataOffset;
+    for (int f = 0; f < header.numFrames; f++) {
+        std::uint64_t bytes = 0;
+        if (offset + sizeof(bytes) <= size) std::memcpy(&bytes, mapping + offset, sizeof(bytes));
+        std::size_t padded = static_cast<std::size_t>((bytes + 7) / 8 * 8);
+        bool fits = offset + sizeof(bytes) <= size && bytes <= size && padded <= size - offset - sizeof(bytes);
+        if (!fits || (header.codec == FrameCodec::Raw && !header.tiled() && bytes != header.frameBytes())) {
+            std::cerr << "Error: " << filename << " declares " << header.numFrames << " frames but frame " << f
+                      << " is " << (fits ? "the wrong size" : "truncated") << std::endl;
+            return false;
+        }
+        builtIndex[f].offset = offset + sizeof(bytes);
+        builtIndex[f].payloadBytes = bytes;
+        builtIndex[f].time = f;
+        offset += sizeof(bytes) + padded;
+    }
+    entries = builtIndex.data();
+    return true;
+}
+
+int MappedFrameFile::findFrame(double time) const {
+    const FrameIndexEntry* end = entries + header.numFrames;
+    const FrameIndexEntry* found = std::lower_bound(entries, end, time, [](const FrameIndexEntry& entry, double t) {
+        return entry.time < t;
+    });
+    return static_cast<int>(found - entries);
+}
+
+bool MappedFrameFile::decode(int index) const {
+    std::size_t count = header.frameBytes() / header.bytesPerValue();
+    bool keyframe = header.isKeyframe(index);
+    if (header.precision == Precision::Float) {
+        return floatDecoder.decode(payload(index), entries[index].payloadBytes, count, keyframe,
+                                   reinterpret_cast<float*>(decoded.data()));
+    }
+    return doubleDecoder.decode(payload(index), entries[index].payloadBytes, count, keyframe, decoded.data());
+}
+
+// Brings one tile's values up to frame index
+bool MappedFrameFile::decodeTile(int t, int index) const {
+    Tile& tile = tiles[t];
+    if (tile.decodedIndex == index) return true;
+
+    // like whole frames, every tile from the keyframe on predicts from the one before it
+    int start = index;
+    if (header.codec != FrameCodec::Raw) {
+        start = index - index % header.keyframeInterval;
+        if (tile.decodedIndex >= start && tile.decodedIndex < index) start = tile.decodedIndex + 1;
+    }
+    int size = header.tileSize;
+    int rows = std::min(size, header.height - t / header.tilesX() * size);
+    int cols = std::min(size, header.width - t % header.tilesX() * size);
+    std::size_t count = static_cast<std::size_t>(rows) * cols * 2;
+    std::size_t tableBytes = (static_cast<std::size_t>(header.tileCount()) + 1) * sizeof(std::uint64_t);
+
+    for (int f = start; f <= index; f++) {
+        const unsigned char* data = payload(f);
+        std::size_t bytes = entries[f].payloadBytes;
+        std::uint64_t begin = 0;
+        std::uint64_t end = 0;
+        bool ok = tableBytes <= bytes;
+        if (ok) {
+            std::memcpy(&begin, data + t * sizeof(begin), sizeof(begin));
+            std::memcpy(&end, data + (t + 1) * sizeof(end), sizeof(end));
+            ok = begin <= end && end <= bytes - tableBytes;
+        }
+        const unsigned char* coded = data + tableBytes + begin;
+        if (ok && header.precision == Precision::Float) {
+            ok = tile.floatDecoder.decode(coded, end - begin, count, header.isKeyframe(f),
+                                          reinterpret_cast<float*>(tile.values.data()));
+        }
+        else if (ok) {
+            ok = tile.doubleDecoder.decode(coded, end - begin, count, header.isKeyframe(f), tile.values.data());
+        }
+        if (!ok) {
+            std::cerr << "Error: tile " << t << " of frame " << f << " is corrupt" << std::endl;
+            tile.decodedIndex = -1;
+            return false;
+        }
+    }
+    tile.decodedIndex = index;
+    return true;
+}
+
+FrameView MappedFrameFile::frame(int index) const {
+    FrameView view;
+    if (index < 0 || index >= header.numFrames) {
+        std::cerr << "Error: frame " << index << " is outside the file (" << header.numFrames << " frames)" << std::endl;
+        return view;
+    }
+    if (header.codec == FrameCodec::Raw && !header.tiled()) {
+        view.data = payload(index);
+    }
+    else {
+        if (index != decodedIndex) {
+            bool ok = true;
+            if (header.tiled()) {
+                // every tile, copied into its place in the frame
+                std::size_t cellBytes = 2 * header.bytesPerValue();
+                unsigned char* out = reinterpret_cast<unsigned char*>(decoded.data());
+                int size = header.tileSize;
+                for (int t = 0; ok && t < header.tileCount(); t++) {
+                    ok = decodeTile(t, index);
+                    int x0 = t % header.tilesX() * size;
+                    int y0 = t / header.tilesX() * size;
+                    int rows = std::min(size, header.height - y0);
+                    int cols = std::min(size, header.width - x0);
+                    const unsigned char* values = reinterpret_cast<const unsigned char*>(tiles[t].values.data());
+                    for (int r = 0; ok && r < rows; r++) {
+                        std::memcpy(out + (static_cast<std::size_t>(y0 + r) * header.width + x0) * cellBytes,
+                                    values + static_cast<std::size_t>(r) * cols * cellBytes, cols * cellBytes);
+                    }
+                }
+            }
+            else {
+                // every frame from the keyframe on predicts from the one before it
+                int start = index - index % header.keyframeInterval;
+                if (decodedIndex >= start && decodedIndex < index) start = decodedIndex + 1;
+                for (int f = start; ok && f <= index; f++) {
+                    ok = decode(f);
+                    if (!ok) std::cerr << "Error: frame " << f << " is corrupt" << std::endl;
+                }
+            }
+            if (!ok) {
+                std::fill(decoded.begin(), decoded.end(), 0.0);
+                index = -1;
+            }
+            decodedIndex = index;
+        }
+        view.data = reinterpret_cast<const unsigned char*>(decoded.data());
+    }
+    view.width = header.width;
+    view.height = header.height;
+    view.precision = header.precision;
+    return view;
+}
+
+template <typename Real>
+bool MappedFrameFile::readRegion(int index, int x0, int y0, int w, int h, BasicVelocityField<Real>& region) const {
+    if (index < 0 || index >= header.numFrames || x0 < 0 || y0 < 0 || w <= 0 || h <= 0 ||
+        x0 + w > header.width || y0 + h > header.height) {
+        std::cerr << "Error: region " << w << "x" << h << " at (" << x0 << ", " << y0 << ") of frame " << index
+                  << " is outside the file" << std::endl;
+        return false;
+    }
+    if (region.rows() != h || region.cols() != w) {
+        region.resize(h, w);
+    }
+    std::size_t cellBytes = 2 * header.bytesPerValue();
+
+    if (!header.tiled()) {
+        FrameView view = frame(index);
+        for (int r = 0; r < h; r++) {
+            copyCells(view.row(y0 + r) + x0 * cellBytes, region.u.row(r), region.v.row(r), w, header.precision);
+        }
+        return true;
+    }
+
+    int size = header.tileSize;
+    for (int ty = y0 / size; ty <= (y0 + h - 1) / size; ty++) {
+        for (int tx = x0 / size; tx <= (x0 + w - 1) / size; tx++) {
+            int t = ty * header.tilesX() + tx;
+            if (!decodeTile(t, index)) return false;
+
+            // the part of the tile inside the region
+            int cols = std::min(size, header.width - tx * size);
+            int rowBegin = std::max(y0, ty * size);
+            int rowEnd = std::min(y0 + h, ty * size + size);
+            int colBegin = std::max(x0, tx * size);
+            int colEnd = std::min(x0 + w, tx * size + size);
+            const unsigned char* values = reinterpret_cast<const unsigned char*>(tiles[t].values.data());
+            for (int r = rowBegin; r < rowEnd; r++) {
+                const unsigned char* source = values + (static_cast<std::size_t>(r - ty * size) * cols + (colBegin - tx * size)) * cellBytes;
+                copyCells(source, region.u.row(r - y0) + (colBegin - x0), region.v.row(r - y0) + (colBegin - x0),
+                          colEnd - colBegin, header.precision);
+            }
+        }
+    }
+    return true;
+}
+
+template bool MappedFrameFile::readRegion<float>(int, int, int, int, int, BasicVelocityField<float>&) const;
+template bool MappedFrameFile::readRegion<double>(int, int, int, int, int, BasicVelocityField<double>&) const;
@@ -0,0 +1,134 @@
+#ifndef MAPPED_FRAME_FILE_HPP
+#define MAPPED_FRAME_FILE_HPP
+
+#include "coords.hpp"
+#include "frame_io.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// One frame inside a mapped frame file: height rows of width interleaved (vx, vy) cells in
+// the file's precision. A view copies nothing and is valid while its MappedFrameFile is open.
+struct FrameView {
+    const unsigned char* data = nullptr;
+    int width = 0;
+    int height = 0;
+    Precision precision = Precision::Double;
+
+    std::size_t valueBytes() const { return precision == Precision::Float ? sizeof(float) : sizeof(double); }
+    const unsigned char* row(int i) const { return data + static_cast<std::size_t>(i) * 2 * width * valueBytes(); }
+
+    // Velocity of cell (i, j), widened to double
+    Vec at(int i, int j) const {
+        const unsigned char* cell = row(i) + static_cast<std::size_t>(j) * 2 * valueBytes();
+        if (precision == Precision::Float) {
+            float value[2];
+            std::memcpy(value, cell, sizeof(value));
+            return Vec(value[0], value[1]);
+        }
+        double value[2];
+        std::memcpy(value, cell, sizeof(value));
+        return Vec(value[0], value[1]);
+    }
+
+    // The interleaved values as Real, for tight loops; nullptr when the file holds the other
+    // precision or the values are not aligned for Real (legacy files start doubles at byte 12)
+    template <typename Real>
+    const Real* values() const {
+        if (precision != precisionOf<Real>() || reinterpret_cast<std::uintptr_t>(data) % alignof(Real) != 0) {
+            return nullptr;
+        }
+        return reinterpret_cast<const Real*>(data);
+    }
+};
+
+// Read-only memory mapping of a frame file (see frame_io.hpp for the layout). open()
+// validates the header and that the file holds every frame it declares, reading only the
+// footer index when the file has one; any frame is then found in constant time, and raw
+// frames are served straight from the page cache. Compressed frames are decoded into one cached frame,
+// continuing from the previous decode when playing forward and from the frame's keyframe
+// otherwise, so views of them last until the next frame() call and one file must not be
+// read from several threads.
+class MappedFrameFile {
+public:
+    MappedFrameFile() = default;
+    ~MappedFrameFile();
+
+    MappedFrameFile(const MappedFrameFile&) = delete;
+    MappedFrameFile& operator=(const MappedFrameFile&) = delete;
+
+    // Maps filename, replacing any file mapped before. Prints the problem and returns false
+    // if the file cannot be mapped or its header or size is invalid.
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+    int frameCount() const { return header.numFrames; }
+    int width() const { return header.width; }
+    int height() const { return header.height; }
+    Precision precision() const { return header.precision; }
+    std::size_t fileSize() const { return size; }
+
+    FrameCodec codec() const { return header.codec; }
+
+    // Whether the file carries a footer index. Without one, frameInfo() has no statistics
+    // and frame numbers for times.
+    bool hasIndex() const { return entries != builtIndex.data(); }
+
+    // Offset, stored size, time and min/max of a frame, straight from the index
+    const FrameIndexEntry& frameInfo(int index) const { return entries[index]; }
+
+    // The first frame at or after time (frameCount() if there is none), by binary search
+    int findFrame(double time) const;
+
+    // Blends the writer asks players to compute between stored frames
+    int inBetweens() const { return header.inBetweens; }
+
+    bool tiled() const { return header.tiled(); }
+    int tileSize() const { return header.tileSize; }
+
+    // Copies the w x h cells at column x0, row y0 of a frame into region, resized to h x w.
+    // A tiled file decodes only the tiles the region overlaps. Prints the problem and returns
+    // false if the region is outside the frame or a tile is corrupt.
+    template <typename Real>
+    bool readRegion(int index, int x0, int y0, int w, int h, BasicVelocityField<Real>& region) const;
+
+    // A view of frame index. An index outside [0, frameCount()) prints the problem and gives
+    // a view with null data.
+    FrameView frame(int index) const;
+
+private:
+    const unsigned char* mapping = nullptr;
+    std::size_t size = 0;
+    FrameFileHeader header;
+    const FrameIndexEntry* entries = nullptr;   // the footer in the mapping, or builtIndex
+    std::vector<FrameIndexEntry> builtIndex;    // files without a (valid) footer
+
+    mutable std::vector<double> decoded;        // compressed files: the last decoded frame
+    mutable int decodedIndex = -1;
+    mutable FrameDecoder<float> floatDecoder{FrameCodec::Raw, 0};
+    mutable FrameDecoder<double> doubleDecoder{FrameCodec::Raw, 0};
+
+    // tiled files: every tile's decoder and last decoded values
+    struct Tile {
+        FrameDecoder<float> floatDecoder{FrameCodec::Raw, 0};
+        FrameDecoder<double> doubleDecoder{FrameCodec::Raw, 0};
+        std::vector<double> values;
+        int decodedIndex = -1;
+    };
+    mutable std::vector<Tile> tiles;
+
+    const unsigned char* payload(int index) const { return mapping + entries[index].offset; }
+    bool useFooterIndex(const std::string& filename);
+    bool walkFrames(const std::string& filename);
+    bool decode(int index) const;
+    bool decodeTile(int tile, int index) const;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+#endif // MAPPED_FRAME_FILE_HPP
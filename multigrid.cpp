@@ -0,0 +1,149 @@
+#include "multigrid.hpp"
+#include <algorithm>
+
+template <typename Real>
+void MultigridSolver<Real>::resize(int rows, int cols) {
+    levels.clear();
+    levels.emplace_back();
+    levels[0].residual.resize(rows, cols, 0.0);
+
+    while (std::min(rows, cols) > coarsestSize) {
+        rows = (rows + 1) / 2;
+        cols = (cols + 1) / 2;
+        Level coarse;
+        coarse.pressure.resize(rows, cols, 0.0, 1);
+        coarse.rhs.resize(rows, cols, 0.0);
+        coarse.residual.resize(rows, cols, 0.0);
+        levels.push_back(std::move(coarse));
+    }
+}
+
+template <typename Real>
+void MultigridSolver<Real>::solve(Field2D<Real>& p, const Field2D<Real>& rhs, int cycles) {
+    for (int c = 0; c < cycles; c++) {
+        cycle(0, p, rhs);
+    }
+}
+
+template <typename Real>
+BoundaryCondition MultigridSolver<Real>::coarseCondition() const {
+    return boundaryCondition == BoundaryCondition::Zero ? BoundaryCondition::Antisymmetric : boundaryCondition;
+}
+
+template <typename Real>
+void MultigridSolver<Real>::cycle(int level, Field2D<Real>& p, const Field2D<Real>& rhs) {
+    BoundaryCondition condition = (level == 0) ? boundaryCondition : coarseCondition();
+    if (level + 1 == static_cast<int>(levels.size())) {
+        smooth(p, rhs, coarsestSweeps, condition);
+        return;
+    }
+
+    smooth(p, rhs, preSmoothing, condition);
+    computeResidual(p, rhs, levels[level].residual, condition);
+
+    Level& coarse = levels[level + 1];
+    restrictResidual(levels[level].residual, coarse);
+    coarse.pressure.fill(0.0);
+
+    // a W-cycle visits each coarser level twice; the coarsest solve is already exact enough
+    bool twice = cycleType == MultigridCycle::W && level + 2 < static_cast<int>(levels.size());
+    cycle(level + 1, coarse.pressure, coarse.rhs);
+    if (twice) {
+        cycle(level + 1, coarse.pressure, coarse.rhs);
+    }
+
+    prolongAndCorrect(coarse.pressure, p);
+    smooth(p, rhs, postSmoothing, condition);
+}
+
+template <typename Real>
+void MultigridSolver<Real>::smooth(Field2D<Real>& p, const Field2D<Real>& rhs, int sweeps) {
+    smooth(p, rhs, sweeps, boundaryCondition);
+}
+
+template <typename Real>
+void MultigridSolver<Real>::computeResidual(Field2D<Real>& p, const Field2D<Real>& rhs, Field2D<Real>& residual) {
+    computeResidual(p, rhs, residual, boundaryCondition);
+}
+
+template <typename Real>
+void MultigridSolver<Real>::smooth(Field2D<Real>& p, const Field2D<Real>& rhs, int sweeps, BoundaryCondition condition) {
+    int rows = p.rows();
+    int cols = p.cols();
+    for (int sweep = 0; sweep < sweeps; sweep++) {
+        for (int color = 0; color < 2; color++) {
+            p.fillBoundary(condition);
+            parallelRows(pool, rows, [&](int rowBegin, int rowEnd) {
+                for (int i = rowBegin; i < rowEnd; i++) {
+                    kernels->redBlackRow(p.row(i), p.row(i - 1), p.row(i + 1), rhs.row(i), cols, (i + color) % 2);
+                }
+            });
+        }
+    }
+}
+
+template <typename Real>
+void MultigridSolver<Real>::computeResidual(Field2D<Real>& p, const Field2D<Real>& rhs, Field2D<Real>& residual,
+                                      BoundaryCondition condition) {
+    int cols = p.cols();
+    p.fillBoundary(condition);
+    parallelRows(pool, p.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            const Real* up = p.row(i - 1);
+            const Real* mid = p.row(i);
+            const Real* down = p.row(i + 1);
+            const Real* b = rhs.row(i);
+            Real* r = residual.row(i);
+            for (int j = 0; j < cols; j++) {
+                r[j] = b[j] - (4 * mid[j] - (mid[j - 1] + mid[j + 1] + up[j] + down[j]));
+            }
+        }
+    });
+}
+
+template <typename Real>
+void MultigridSolver<Real>::restrictResidual(const Field2D<Real>& residual, Level& coarse) {
+    int fineRows = residual.rows();
+    int fineCols = residual.cols();
+    int cols = coarse.rhs.cols();
+    parallelRows(pool, coarse.rhs.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            const Real* top = residual.row(2 * i);
+            const Real* bottom = (2 * i + 1 < fineRows) ? residual.row(2 * i + 1) : nullptr;
+            Real* b = coarse.rhs.row(i);
+            for (int j = 0; j < cols; j++) {
+                int fj = 2 * j;
+                bool hasRight = fj + 1 < fineCols;
+                Real sum = top[fj] + (hasRight ? top[fj + 1] : Real(0));
+                if (bottom) {
+                    sum += bottom[fj] + (hasRight ? bottom[fj + 1] : Real(0));
+                }
+                b[j] = sum;
+            }
+        }
+    });
+}
+
+template <typename Real>
+void MultigridSolver<Real>::prolongAndCorrect(Field2D<Real>& coarsePressure, Field2D<Real>& p) {
+    int cols = p.cols();
+    coarsePressure.fillBoundary(coarseCondition());
+    parallelRows(pool, p.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            // each fine cell sits in a quadrant of its coarse parent and blends toward
+            // the coarse neighbours on that side with weights 9/16, 3/16, 3/16, 1/16
+            int ci = i / 2;
+            const Real* near = coarsePressure.row(ci);
+            const Real* far = coarsePressure.row((i % 2 == 0) ? ci - 1 : ci + 1);
+            Real* fine = p.row(i);
+            for (int j = 0; j < cols; j++) {
+                int cj = j / 2;
+                int oj = (j % 2 == 0) ? cj - 1 : cj + 1;
+                fine[j] += (9 * near[cj] + 3 * near[oj] + 3 * far[cj] + far[oj]) / 16;
+            }
+        }
+    });
+}
+
+template class MultigridSolver<float>;
+template class MultigridSolver<double>;
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef MULTIGRID_HPP
+#define MULTIGRID_HPP
+
+#include "field2d.hpp"
+#include "pressure_solver.hpp"
+#include "stencil_kernels.hpp"
+#include "thread_pool.hpp"
+#include <vector>
+
+enum class MultigridCycle {
+    V,
+    W
+};
+
+// Geometric multigrid for the projection's pressure equation 4p - (pL + pR + pU + pD) = div
+// on a cell-centred grid. Coarse levels halve each dimension down to coarsestSize;
+// restriction sums the four child residuals (the average, rescaled for the doubled spacing),
+// prolongation is bilinear, and red-black Gauss-Seidel smooths on every level.
+// All level storage is allocated by resize(), so cycles allocate nothing.
+// Instantiated for float and double fields.
+template <typename Real>
+class MultigridSolver {
+public:
+    MultigridCycle cycleType = MultigridCycle::V;
+    int preSmoothing = 2;
+    int postSmoothing = 2;
+    int coarsestSize = 4;
+    int coarsestSweeps = 40;
+
+    BoundaryCondition boundaryCondition = BoundaryCondition::Clamp;
+    const StencilKernels<Real>* kernels = &scalarStencilKernels<Real>();
+    ThreadPool* pool = nullptr;
+
+    // Builds the level hierarchy below a rows x cols fine grid
+    void resize(int rows, int cols);
+
+    // Runs cycles on the fine grid, improving p in place. p needs a one-cell halo.
+    void solve(Field2D<Real>& p, const Field2D<Real>& rhs, int cycles);
+
+    int levelCount() const { return static_cast<int>(levels.size()); }
+
+    // Red-black Gauss-Seidel sweeps on any level; also the plain solver's inner loop
+    void smooth(Field2D<Real>& p, const Field2D<Real>& rhs, int sweeps);
+
+    // residual = rhs - (4p - sum of neighbours); refreshes p's halo first
+    void computeResidual(Field2D<Real>& p, const Field2D<Real>& rhs, Field2D<Real>& residual);
+
+private:
+    // Boundary used for corrections on the coarse levels. A zero ghost on the fine grid puts the
+    // wall one fine cell out; coarse levels approximate it with a zero on the cell face instead,
+    // which keeps Dirichlet convergence close to the Neumann rate.
+    BoundaryCondition coarseCondition() const;
+
+    struct Level {
+        Field2D<Real> pressure;  // correction solved on this level, with halo
+        Field2D<Real> rhs;
+        Field2D<Real> residual;
+    };
+
+    // levels[0] is the fine grid, whose pressure and rhs are the caller's fields
+    std::vector<Level> levels;
+
+    void cycle(int level, Field2D<Real>& p, const Field2D<Real>& rhs);
+    void smooth(Field2D<Real>& p, const Field2D<Real>& rhs, int sweeps, BoundaryCondition condition);
+    void computeResidual(Field2D<Real>& p, const Field2D<Real>& rhs, Field2D<Real>& residual,
+                         BoundaryCondition condition);
+    void restrictResidual(const Field2D<Real>& residual, Level& coarse);
+    void prolongAndCorrect(Field2D<Real>& coarsePressure, Field2D<Real>& p);
+};
+
+#endif // MULTIGRID_HPP
@@ -0,0 +1,276 @@
+#include "pcg.hpp"
+#include <cmath>
+
+namespace {
+
+// Sums rowSum(i) over all rows. Each row's partial lands in its own slot and the slots are
+// added in order afterwards, so the result is the same for any thread count.
+template <typename RowSum>
+double reduceRows(ThreadPool* pool, Field2D<double>& rowSums, RowSum&& rowSum) {
+    parallelRows(pool, rowSums.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            rowSums(i, 0) = rowSum(i);
+        }
+    });
+    double total = 0;
+    for (int i = 0; i < rowSums.rows(); i++) {
+        total += rowSums(i, 0);
+    }
+    return total;
+}
+
+}
+
+template <typename Real>
+void PcgSolver<Real>::resize(int rows, int cols) {
+    b.resize(rows, cols, 0.0);
+    residual.resize(rows, cols, 0.0);
+    direction.resize(rows, cols, 0.0, 1);
+    product.resize(rows, cols, 0.0);
+    preconditioned.resize(rows, cols, 0.0, 1);
+    rowSums.resize(rows, 1, 0.0);
+    factorDiagonal.resize(rows, cols, 0.0);
+    factored = false;
+}
+
+template <typename Real>
+bool PcgSolver<Real>::singular() const {
+    // only constant fields are lost by the operator under these conditions
+    return boundaryCondition == BoundaryCondition::Clamp || boundaryCondition == BoundaryCondition::Periodic;
+}
+
+template <typename Real>
+double PcgSolver<Real>::operatorDiagonal(int i, int j) const {
+    int edges = (i == 0) + (i == b.rows() - 1) + (j == 0) + (j == b.cols() - 1);
+    switch (boundaryCondition) {
+        case BoundaryCondition::Clamp: return 4.0 - edges;
+        case BoundaryCondition::Antisymmetric: return 4.0 + edges;
+        default: return 4.0;
+    }
+}
+
+template <typename Real>
+SolveStats PcgSolver<Real>::solve(Field2D<Real>& p, const Field2D<Real>& rhs) {
+    SolveStats stats;
+    int cols = p.cols();
+
+    parallelRows(pool, p.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            std::copy(rhs.row(i), rhs.row(i) + cols, b.row(i));
+        }
+    });
+    if (singular()) {
+        removeMean(b);
+    }
+
+    double bNorm = std::sqrt(dot(b, b));
+    if (bNorm == 0) {
+        stats.residual = 0;
+        return stats;
+    }
+
+    if (preconditioner == Preconditioner::IncompleteCholesky && (!factored || factoredCondition != boundaryCondition)) {
+        factorIncompleteCholesky();
+    }
+
+    applyOperator(p, product);
+    double rr = reduceRows(pool, rowSums, [&](int i) {
+        const Real* bRow = b.row(i);
+        const Real* q = product.row(i);
+        Real* r = residual.row(i);
+        double sum = 0;
+        for (int j = 0; j < cols; j++) {
+            r[j] = bRow[j] - q[j];
+            sum += r[j] * r[j];
+        }
+        return sum;
+    });
+    stats.residual = std::sqrt(rr) / bNorm;
+    if (stats.residual <= tolerance) {
+        return stats;
+    }
+
+    applyPreconditioner(residual, preconditioned);
+    parallelRows(pool, p.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            std::copy(preconditioned.row(i), preconditioned.row(i) + cols, direction.row(i));
+        }
+    });
+    double rz = dot(residual, preconditioned);
+
+    while (stats.iterations < maxIterations) {
+        applyOperator(direction, product);
+        double curvature = dot(direction, product);
+        if (curvature <= 0) break;
+        double step = rz / curvature;
+        Real realStep = Real(step);
+
+        rr = reduceRows(pool, rowSums, [&](int i) {
+            const Real* d = direction.row(i);
+            const Real* q = product.row(i);
+            Real* x = p.row(i);
+            Real* r = residual.row(i);
+            double sum = 0;
+            for (int j = 0; j < cols; j++) {
+                x[j] += realStep * d[j];
+                r[j] -= realStep * q[j];
+                sum += r[j] * r[j];
+            }
+            return sum;
+        });
+        stats.iterations++;
+        stats.residual = std::sqrt(rr) / bNorm;
+        if (stats.residual <= tolerance) break;
+
+        // Polak-Ribiere: beta = r.(z - zOld) / rzOld, which reduces to the usual
+        // Fletcher-Reeves value when the preconditioner is a fixed symmetric operator
+        double rzOld = dot(residual, preconditioned);
+        applyPreconditioner(residual, preconditioned);
+        double rzNew = dot(residual, preconditioned);
+        double beta = std::max(0.0, (rzNew - rzOld) / rz);
+        rz = rzNew;
+        Real realBeta = Real(beta);
+
+        parallelRows(pool, p.rows(), [&](int rowBegin, int rowEnd) {
+            for (int i = rowBegin; i < rowEnd; i++) {
+                const Real* z = preconditioned.row(i);
+                Real* d = direction.row(i);
+                for (int j = 0; j < cols; j++) {
+                    d[j] = z[j] + realBeta * d[j];
+                }
+            }
+        });
+    }
+    stats.converged = stats.residual <= tolerance;
+    return stats;
+}
+
+template <typename Real>
+void PcgSolver<Real>::applyOperator(Field2D<Real>& x, Field2D<Real>& out) {
+    int cols = x.cols();
+    x.fillBoundary(boundaryCondition);
+    parallelRows(pool, x.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            const Real* up = x.row(i - 1);
+            const Real* mid = x.row(i);
+            const Real* down = x.row(i + 1);
+            Real* o = out.row(i);
+            for (int j = 0; j < cols; j++) {
+                o[j] = 4 * mid[j] - (mid[j - 1] + mid[j + 1] + up[j] + down[j]);
+            }
+        }
+    });
+}
+
+template <typename Real>
+void PcgSolver<Real>::applyPreconditioner(const Field2D<Real>& r, Field2D<Real>& z) {
+    int rows = r.rows();
+    int cols = r.cols();
+
+    switch (preconditioner) {
+        case Preconditioner::Jacobi:
+            parallelRows(pool, rows, [&](int rowBegin, int rowEnd) {
+                for (int i = rowBegin; i < rowEnd; i++) {
+                    for (int j = 0; j < cols; j++) {
+                        z(i, j) = r(i, j) / operatorDiagonal(i, j);
+                    }
+                }
+            });
+            break;
+
+        case Preconditioner::IncompleteCholesky:
+            // forward sweep (D + L) w = r, then backward sweep (D + L^T) z = D w; the
+            // off-diagonal entries are -1, so each step only adds the already solved neighbours
+            for (int i = 0; i < rows; i++) {
+                for (int j = 0; j < cols; j++) {
+                    double sum = r(i, j);
+                    if (i > 0) sum += z(i - 1, j);
+                    if (j > 0) sum += z(i, j - 1);
+                    z(i, j) = sum / factorDiagonal(i, j);
+                }
+            }
+            for (int i = rows - 1; i >= 0; i--) {
+                for (int j = cols - 1; j >= 0; j--) {
+                    double sum = 0;
+                    if (i + 1 < rows) sum += z(i + 1, j);
+                    if (j + 1 < cols) sum += z(i, j + 1);
+                    z(i, j) += sum / factorDiagonal(i, j);
+                }
+            }
+            break;
+
+        case Preconditioner::Multigrid:
+            z.fill(0.0);
+            multigrid->boundaryCondition = boundaryCondition;
+            multigrid->solve(z, r, 1);
+            break;
+    }
+
+    if (singular()) {
+        removeMean(z);
+    }
+}
+
+template <typename Real>
+void PcgSolver<Real>::factorIncompleteCholesky() {
+    int rows = b.rows();
+    int cols = b.cols();
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            double a = operatorDiagonal(i, j);
+            double d = a;
+            if (i > 0) d -= 1.0 / factorDiagonal(i - 1, j);
+            if (j > 0) d -= 1.0 / factorDiagonal(i, j - 1);
+            // the singular operator drives the last pivots toward zero; fall back to the
+            // plain diagonal there rather than amplify round-off
+            factorDiagonal(i, j) = (d < 0.25 * a) ? a : d;
+        }
+    }
+    factored = true;
+    factoredCondition = boundaryCondition;
+}
+
+template <typename Real>
+double PcgSolver<Real>::dot(const Field2D<Real>& x, const Field2D<Real>& y) {
+    int cols = x.cols();
+    return reduceRows(pool, rowSums, [&](int i) {
+        const Real* xRow = x.row(i);
+        const Real* yRow = y.row(i);
+        double sum = 0;
+        for (int j = 0; j < cols; j++) {
+            sum += xRow[j] * yRow[j];
+        }
+        return sum;
+    });
+}
+
+template <typename Real>
+double PcgSolver<Real>::mean(const Field2D<Real>& x) {
+    int cols = x.cols();
+    double total = reduceRows(pool, rowSums, [&](int i) {
+        const Real* xRow = x.row(i);
+        double sum = 0;
+        for (int j = 0; j < cols; j++) {
+            sum += xRow[j];
+        }
+        return sum;
+    });
+    return total / static_cast<double>(x.size());
+}
+
+template <typename Real>
+void PcgSolver<Real>::removeMean(Field2D<Real>& x) {
+    Real m = Real(mean(x));
+    int cols = x.cols();
+    parallelRows(pool, x.rows(), [&](int rowBegin, int rowEnd) {
+        for (int i = rowBegin; i < rowEnd; i++) {
+            Real* xRow = x.row(i);
+            for (int j = 0; j < cols; j++) {
+                xRow[j] -= m;
+            }
+        }
+    });
+}
+
+template class PcgSolver<float>;
+template class PcgSolver<double>;
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef PCG_HPP
+#define PCG_HPP
+
+#include "field2d.hpp"
+#include "multigrid.hpp"
+#include "pressure_solver.hpp"
+#include "stencil_kernels.hpp"
+#include "thread_pool.hpp"
+
+enum class Preconditioner {
+    Jacobi,              // divide by the operator diagonal
+    IncompleteCholesky,  // IC(0) of the five-point operator, applied with two triangular sweeps
+    Multigrid            // one multigrid V-cycle from a zero guess
+};
+
+// Matrix-free preconditioned conjugate gradient for the pressure equation
+// 4p - (pL + pR + pU + pD) = div, with neighbours taken from the halo like every other
+// sweep. It stops once ||b - Ap|| / ||b|| drops to tolerance or after maxIterations.
+// Clamp and periodic boundaries make the operator singular, so the constant part of the
+// right-hand side is removed first. The Polak-Ribiere update keeps CG stable with the
+// slightly nonsymmetric multigrid preconditioner. Storage is allocated by resize().
+// Instantiated for float and double fields; dot products always accumulate in double.
+template <typename Real>
+class PcgSolver {
+public:
+    Preconditioner preconditioner = Preconditioner::Jacobi;
+    double tolerance = 1e-4;
+    int maxIterations = 500;
+
+    BoundaryCondition boundaryCondition = BoundaryCondition::Clamp;
+    ThreadPool* pool = nullptr;
+    MultigridSolver<Real>* multigrid = nullptr;  // required by the multigrid preconditioner
+
+    void resize(int rows, int cols);
+
+    // Improves p in place, starting from its current value. p needs a one-cell halo.
+    SolveStats solve(Field2D<Real>& p, const Field2D<Real>& rhs);
+
+private:
+    Field2D<Real> b;          // right-hand side, constant part removed when singular
+    Field2D<Real> residual;
+    Field2D<Real> direction;  // with halo, the operator is applied to it
+    Field2D<Real> product;    // operator applied to direction
+    Field2D<Real> preconditioned;  // with halo, the multigrid preconditioner smooths it
+    Field2D<double> rowSums;    // one partial sum per row, so reductions do not depend on thread count
+
+    // IC(0) factor diagonal, rebuilt when the boundary condition changes
+    Field2D<Real> factorDiagonal;
+    bool factored = false;
+    BoundaryCondition factoredCondition = BoundaryCondition::Clamp;
+
+    bool singular() const;
+    double operatorDiagonal(int i, int j) const;
+    void applyOperator(Field2D<Real>& x, Field2D<Real>& out);
+    void applyPreconditioner(const Field2D<Real>& r, Field2D<Real>& z);
+    void factorIncompleteCholesky();
+    double dot(const Field2D<Real>& x, const Field2D<Real>& y);
+    double mean(const Field2D<Real>& x);
+    void removeMean(Field2D<Real>& x);
+};
+
+#endif // PCG_HPP
@@ -0,0 +1,21 @@
+#ifndef PRESSURE_SOLVER_HPP
+#define PRESSURE_SOLVER_HPP
+
+// Pressure Poisson solver used by the projection step
+enum class PressureSolver {
+    GaussSeidel,       // fixed number of red-black sweeps
+    Multigrid,         // geometric multigrid cycles
+    ConjugateGradient  // preconditioned CG down to a residual tolerance
+};
+
+// What the last iterative solve (pressure or diffusion) did. residual is the norm the
+// solver stops on: ||b - Ap|| / ||b|| for conjugate gradient, the max-norm residual for the
+// Jacobi and Gauss-Seidel sweeps, or -1 when the solver ran a fixed amount of work without measuring it.
+// converged is false when a solver with a tolerance gave up above it.
+struct SolveStats {
+    int iterations = 0;
+    double residual = -1;
+    bool converged = true;
+};
+
+#endif // PRESSURE_SOLVER_HPP
@@ -1,6 +1,31 @@
 #include "raylib_visualizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
+namespace {
+
+// texture0 and nextFrame hold (vx, vy, 0) per cell; the colour is velocityToColor()'s
+const char* BLEND_FRAGMENT_SHADER = R"(
+#version 330
+in vec2 fragTexCoord;
+in vec4 fragColor;
+uniform sampler2D texture0;
+uniform sampler2D nextFrame;
+uniform float blend;
+uniform float speedScale;
+out vec4 finalColor;
+
+void main() {
+    vec2 velocity = mix(texture(texture0, fragTexCoord).xy, texture(nextFrame, fragTexCoord).xy, blend);
+    float intensity = min(1.0, length(velocity) / speedScale);
+    finalColor = vec4(intensity, 1.0 - intensity, 0.5, 1.0);
+}
+)";
+
+}
+
 RaylibVisualizer::RaylibVisualizer(int width, int height)
     : windowWidth(width), windowHeight(height), currentFrame(0), totalFrames(0), isPlaying(true), frameRate(30.0f) {
 }
@@ -10,7 +35,8 @@ RaylibVisualizer::~RaylibVisualizer() {
 }
 
 bool RaylibVisualizer::initialize() {
-    if (!InitWindow(windowWidth, windowHeight, "Navier Stokes Visualizer")) {
+    InitWindow(windowWidth, windowHeight, "Navier Stokes Visualizer");
+    if (!IsWindowReady()) {
         std::cerr << "Failed to initialize raylib window" << std::endl;
         return false;
     }
@@ -22,30 +48,46 @@ bool RaylibVisualizer::initialize() {
     camera.rotation = 0.0f;
     camera.zoom = 1.0f;
 
+    // a shader that fails to compile comes back as the default one, which has no nextFrame
+    blendShader = LoadShaderFromMemory(nullptr, BLEND_FRAGMENT_SHADER);
+    nextFrameLocation = GetShaderLocation(blendShader, "nextFrame");
+    blendLocation = GetShaderLocation(blendShader, "blend");
+    speedScaleLocation = GetShaderLocation(blendShader, "speedScale");
+    shaderBlend = nextFrameLocation >= 0;
+    if (!shaderBlend) {
+        std::cerr << "Blend shader unavailable; blending frames on the CPU" << std::endl;
+    }
+
     lastFrameTime = std::chrono::steady_clock::now();
     return true;
 }
 
 void RaylibVisualizer::cleanup() {
-    if (IsWindowReady()) CloseWindow();
+    if (!IsWindowReady()) return;
+    for (int slot = 0; slot < 2; slot++) {
+        if (frameTextureIndex[slot] >= 0) UnloadTexture(frameTextures[slot]);
+        frameTextureIndex[slot] = -1;
+    }
+    UnloadShader(blendShader);
+    CloseWindow();
 }
 
 Color RaylibVisualizer::velocityToColor(const Vec& velocity) {
     double mag = velocity.magnitude();
     // Clamp and map
-    double v = std::min(1.0, mag / 5.0); // assume velocities ~ [0,5]
+    double v = std::min(1.0, mag / speedScale);
     unsigned char intensity = static_cast<unsigned char>(v * 255);
     return Color{ intensity, static_cast<unsigned char>(255 - intensity), 128, 255 };
 }
 
-void RaylibVisualizer::renderVelocityField(const std::vector<std::vector<Vec>>& frame) {
+void RaylibVisualizer::renderVelocityField(const FrameView& frame) {
     // Create an image and texture sized to grid
     Image img = GenImageColor(gridWidth, gridHeight, BLANK);
     Color* pixels = (Color*)MemAlloc(gridWidth * gridHeight * sizeof(Color));
 
     for (int y = 0; y < gridHeight; y++) {
         for (int x = 0; x < gridWidth; x++) {
-            Vec v = frame[y][x];
+            Vec v = frame.at(y, x);
             Color c = velocityToColor(v);
             pixels[y * gridWidth + x] = c;
         }
@@ -65,32 +107,141 @@ void RaylibVisualizer::renderVelocityField(const std::vector<std::vector<Vec>>&
     UnloadTexture(tex);
 }
 
+void RaylibVisualizer::uploadStoredFrame(int slot, int stored) {
+    FrameView frame = frameFile.frame(stored);
+    uploadBuffer.resize(static_cast<std::size_t>(3) * gridWidth * gridHeight);
+    for (int y = 0; y < gridHeight; y++) {
+        for (int x = 0; x < gridWidth; x++) {
+            Vec v = frame.at(y, x);
+            float* cell = &uploadBuffer[(static_cast<std::size_t>(y) * gridWidth + x) * 3];
+            cell[0] = static_cast<float>(v.x);
+            cell[1] = static_cast<float>(v.y);
+            cell[2] = 0.0f;
+        }
+    }
+
+    if (frameTextureIndex[slot] < 0) {
+        Image img = { uploadBuffer.data(), gridWidth, gridHeight, 1, PIXELFORMAT_UNCOMPRESSED_R32G32B32 };
+        frameTextures[slot] = LoadTextureFromImage(img);
+    }
+    else {
+        UpdateTexture(frameTextures[slot], uploadBuffer.data());
+    }
+    frameTextureIndex[slot] = stored;
+}
+
+void RaylibVisualizer::renderBlended(int played) {
+    int from = playback->storedFrame(played);
+    int step = playback->blendStep(played);
+    int to = step > 0 ? from + 1 : from;
+
+    // playing forward, the later frame becomes the earlier one, so each is uploaded once
+    if (frameTextureIndex[0] != from && frameTextureIndex[1] == from) {
+        std::swap(frameTextures[0], frameTextures[1]);
+        std::swap(frameTextureIndex[0], frameTextureIndex[1]);
+    }
+    if (frameTextureIndex[0] != from) uploadStoredFrame(0, from);
+    int next = 0;
+    if (to != from) {
+        if (frameTextureIndex[1] != to) uploadStoredFrame(1, to);
+        next = 1;
+    }
+
+    float blend = static_cast<float>(step) / (playback->inBetweens() + 1);
+    float scale = static_cast<float>(speedScale);
+    BeginShaderMode(blendShader);
+    SetShaderValueTexture(blendShader, nextFrameLocation, frameTextures[next]);
+    SetShaderValue(blendShader, blendLocation, &blend, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(blendShader, speedScaleLocation, &scale, SHADER_UNIFORM_FLOAT);
+    float scaleX = (float)windowWidth / (float)gridWidth;
+    float scaleY = (float)windowHeight / (float)gridHeight;
+    DrawTextureEx(frameTextures[0], {0,0}, 0.0f, fmin(scaleX, scaleY), WHITE);
+    EndShaderMode();
+}
+
 bool RaylibVisualizer::loadFramesFromFile(const std::string& filename) {
-    grid g;
-    // Use grid::readFramesFromFile to populate generatedFrames
-    g.readFramesFromFile(filename);
-    if (g.generatedFrames.empty()) return false;
-
-    frames = std::move(g.generatedFrames);
-    totalFrames = static_cast<int>(frames.size());
-    gridHeight = frames[0].size();
-    gridWidth = frames[0][0].size();
+    // the file carries its own size and precision; nothing is copied until a frame is drawn
+    if (!frameFile.open(filename) || frameFile.frameCount() == 0) return false;
+
+    gridWidth = frameFile.width();
+    gridHeight = frameFile.height();
+    playback = std::make_unique<InterpolatedFrames>(frameFile, requestedInBetweens);
+    totalFrames = playback->frameCount();
+    std::cout << "Mapped " << frameFile.frameCount() << " " << precisionName(frameFile.precision()) << " frames of "
+              << gridWidth << "x" << gridHeight << " from " << filename << ", playing "
+              << playback->inBetweens() << " in-betweens each" << std::endl;
+    for (int slot = 0; slot < 2; slot++) {
+        if (frameTextureIndex[slot] >= 0) UnloadTexture(frameTextures[slot]);
+        frameTextureIndex[slot] = -1;
+    }
+
+    // the index's statistics give the colour scale without decoding a frame
+    if (frameFile.hasIndex()) {
+        double largest = 0;
+        for (int f = 0; f < frameFile.frameCount(); f++) {
+            largest = std::max(largest, double(frameFile.frameInfo(f).maxSpeed));
+        }
+        if (largest > 0) speedScale = largest;
+    }
+    currentFrame = 0;
     return true;
 }
 
 void RaylibVisualizer::drawUI() {
-    DrawText("Space: Play/Pause  Left/Right: Prev/Next  +/-: FPS", 10, 10, 12, RAYWHITE);
-    DrawText(TextFormat("Frame: %d / %d", currentFrame + 1, totalFrames), 10, 30, 12, RAYWHITE);
-    DrawText(TextFormat("FPS: %.1f", frameRate), 10, 50, 12, RAYWHITE);
+    DrawText("Space: Play/Pause  Left/Right: Prev/Next  PgUp/PgDn/Home/End: Seek  Q: Skip quiet  +/-: FPS  [/]: In-betweens",
+             10, 10, 12, RAYWHITE);
+    DrawText(TextFormat("Frame: %d / %d (stored %d / %d)  t = %.4f", currentFrame + 1, totalFrames,
+                        playback->storedFrame(currentFrame) + 1, frameFile.frameCount(), playback->time(currentFrame)),
+             10, 30, 12, RAYWHITE);
+    DrawText(TextFormat("FPS: %.1f  In-betweens: %d (%s)%s", frameRate, playback->inBetweens(),
+                        shaderBlend ? "shader" : "CPU", skipQuiet ? "  (skipping quiet frames)" : ""), 10, 50, 12, RAYWHITE);
+}
+
+bool RaylibVisualizer::storedQuiet(int stored) const {
+    const FrameIndexEntry& info = frameFile.frameInfo(stored);
+    return (info.flags & FRAME_HAS_STATISTICS) && info.maxSpeed < quietFraction * speedScale;
+}
+
+// An in-between is quiet when both stored frames around it are
+bool RaylibVisualizer::isQuiet(int played) const {
+    int stored = playback->storedFrame(played);
+    return storedQuiet(stored) && (playback->blendStep(played) == 0 || storedQuiet(stored + 1));
 }
 
 void RaylibVisualizer::playPause() { isPlaying = !isPlaying; }
-void RaylibVisualizer::nextFrame() { currentFrame = (currentFrame + 1) % totalFrames; }
+
+void RaylibVisualizer::nextFrame() {
+    // quiet frames are recognised from the index alone; if every frame is quiet, stop after one lap
+    for (int step = 1; step <= totalFrames; step++) {
+        int frame = (currentFrame + step) % totalFrames;
+        if (!skipQuiet || !isQuiet(frame) || step == totalFrames) {
+            currentFrame = frame;
+            return;
+        }
+    }
+}
+
 void RaylibVisualizer::previousFrame() { currentFrame = (currentFrame - 1 + totalFrames) % totalFrames; }
+void RaylibVisualizer::seekFrame(int frame) { currentFrame = std::max(0, std::min(totalFrames - 1, frame)); }
 void RaylibVisualizer::setFrameRate(float fps) { frameRate = fps; }
 
+void RaylibVisualizer::setInBetweens(int inBetweens) {
+    inBetweens = std::max(0, inBetweens);
+    if (!playback) {
+        requestedInBetweens = inBetweens;
+        return;
+    }
+    // stay at the same point between the same stored frames
+    int period = playback->inBetweens() + 1;
+    int stored = playback->storedFrame(currentFrame);
+    int step = playback->blendStep(currentFrame);
+    playback->setInBetweens(inBetweens);
+    totalFrames = playback->frameCount();
+    currentFrame = std::min(totalFrames - 1, playback->playedFrame(stored) + step * (inBetweens + 1) / period);
+}
+
 void RaylibVisualizer::run() {
-    if (frames.empty()) {
+    if (totalFrames == 0) {
         std::cerr << "No frames loaded" << std::endl;
         return;
     }
@@ -100,6 +251,14 @@ void RaylibVisualizer::run() {
         if (IsKeyPressed(KEY_SPACE)) playPause();
         if (IsKeyPressed(KEY_RIGHT)) nextFrame();
         if (IsKeyPressed(KEY_LEFT)) previousFrame();
+        // any frame is one index lookup away, compressed or not
+        if (IsKeyPressed(KEY_PAGE_DOWN)) seekFrame(currentFrame + std::max(1, totalFrames / 10));
+        if (IsKeyPressed(KEY_PAGE_UP)) seekFrame(currentFrame - std::max(1, totalFrames / 10));
+        if (IsKeyPressed(KEY_HOME)) seekFrame(0);
+        if (IsKeyPressed(KEY_END)) seekFrame(totalFrames - 1);
+        if (IsKeyPressed(KEY_Q)) skipQuiet = !skipQuiet;
+        if (IsKeyPressed(KEY_RIGHT_BRACKET)) setInBetweens(playback->inBetweens() + 1);
+        if (IsKeyPressed(KEY_LEFT_BRACKET)) setInBetweens(playback->inBetweens() - 1);
         if (IsKeyPressed(KEY_KP_ADD) || IsKeyPressed(KEY_EQUAL)) frameRate += 1.0f;
         if (IsKeyPressed(KEY_KP_SUBTRACT) || IsKeyPressed(KEY_MINUS)) frameRate = std::max(1.0f, frameRate - 1.0f);
 
@@ -107,14 +266,19 @@ void RaylibVisualizer::run() {
         auto now = std::chrono::steady_clock::now();
         double elapsed = std::chrono::duration<double>(now - lastFrameTime).count();
         if (isPlaying && elapsed >= 1.0 / frameRate) {
-            currentFrame = (currentFrame + 1) % totalFrames;
+            nextFrame();
             lastFrameTime = now;
         }
 
         BeginDrawing();
         ClearBackground(BLACK);
 
-        renderVelocityField(frames[currentFrame]);
+        if (shaderBlend) {
+            renderBlended(currentFrame);
+        }
+        else {
+            renderVelocityField(playback->frame(currentFrame));
+        }
         drawUI();
 
         EndDrawing();
@@ -1,7 +1,9 @@
 #pragma once
 
-#include "grid.hpp"
+#include "interpolated_frames.hpp"
+#include "mapped_frame_file.hpp"
 #include <raylib.h>
+#include <memory>
 #include <vector>
 #include <fstream>
 #include <chrono>
@@ -15,10 +17,33 @@ private:
     RenderTexture2D renderTexture;
     Camera2D camera;
     
-    // Simulation data
-    std::vector<std::vector<std::vector<Vec>>> frames;
+    // Simulation data, read in place from the mapped file. Playback adds in-betweens on
+    // demand, so currentFrame and totalFrames count played frames, not stored ones.
+    MappedFrameFile frameFile;
+    std::unique_ptr<InterpolatedFrames> playback;
+    int requestedInBetweens = -1;     // -1 plays what the file asks for
     int currentFrame;
     int totalFrames;
+
+    // In-betweens are mixed on the GPU: the stored frames on either side of the current one are
+    // float textures of (vx, vy, 0), each uploaded once, and the fragment shader mixes them and
+    // maps the speed to a colour. Without the shader, frames are blended and coloured on the CPU.
+    Shader blendShader = {};
+    bool shaderBlend = false;
+    int blendLocation = -1;
+    int nextFrameLocation = -1;
+    int speedScaleLocation = -1;
+    Texture2D frameTextures[2] = {};
+    int frameTextureIndex[2] = { -1, -1 };   // stored frame in each texture
+    std::vector<float> uploadBuffer;
+
+    // Colour scale: the largest speed in the file's index, if it has one
+    double speedScale = 5.0;
+
+    // With skipQuiet, playback passes over frames whose indexed max speed is below
+    // quietFraction of speedScale, without decoding them
+    bool skipQuiet = false;
+    double quietFraction = 0.01;
     
     // Animation control
     bool isPlaying;
@@ -26,18 +51,22 @@ private:
     std::chrono::steady_clock::time_point lastFrameTime;
     
     // Rendering
-    void renderVelocityField(const std::vector<std::vector<Vec>>& frame);
+    void renderVelocityField(const FrameView& frame);
+    void renderBlended(int played);
+    void uploadStoredFrame(int slot, int stored);
+    bool storedQuiet(int stored) const;
+    bool isQuiet(int played) const;
     Color velocityToColor(const Vec& velocity);
     void drawUI();
     
-    // File I/O
-    bool loadFramesFromFile(const std::string& filename);
-    
 public:
     RaylibVisualizer(int width = 800, int height = 600);
     ~RaylibVisualizer();
     
     bool initialize();
+
+    // Maps the frame file; frames are drawn straight from the mapping
+    bool loadFramesFromFile(const std::string& filename);
     void run();
     void cleanup();
     
@@ -45,5 +74,8 @@ public:
     void playPause();
     void nextFrame();
     void previousFrame();
+    void seekFrame(int frame);
     void setFrameRate(float fps);
+    // Played frames between stored ones; before loading, overrides what the file asks for
+    void setInBetweens(int inBetweens);
 };
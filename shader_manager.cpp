@@ -62,17 +62,52 @@ GLuint ShaderManager::createComputeProgram(const std::string& name, GLuint shade
 }
 
 // Shader Sources
+// Adds every queued force splat in one pass over the cells they cover. Each splat adds
+// force * strength * (1 - distance / radius)^falloff to the cells within radius of its centre;
+// overlapping splats add up in the order they were queued.
 const std::string ShaderManager::FORCE_SHADER_SOURCE = R"(
 #version 430
 layout(local_size_x = 16, local_size_y = 16) in;
 layout(rg32f, binding = 0) uniform image2D velocityField;
 
-uniform float timeStep;
+struct Splat {
+    vec2 position;    // in cells
+    vec2 force;
+    float radius;
+    float strength;
+    float falloff;
+    float padding;
+};
+
+layout(std430, binding = 0) readonly buffer Splats {
+    Splat splats[];
+};
+
 uniform int width;
 uniform int height;
+uniform ivec2 origin;     // first cell of the region the dispatch covers
+uniform int splatCount;
 
 void main() {
+    ivec2 pos = origin + ivec2(gl_GlobalInvocationID.xy);
+    if (pos.x >= width || pos.y >= height) return;
 
+    vec2 velocity = imageLoad(velocityField, pos).xy;
+    bool changed = false;
+    for (int s = 0; s < splatCount; s++) {
+        float dist = length(vec2(pos) - splats[s].position);
+        if (dist <= splats[s].radius) {
+            // pow is only approximate, and a linear falloff is the common case
+            float shape = 1.0 - dist / splats[s].radius;
+            if (splats[s].falloff != 1.0) shape = pow(shape, splats[s].falloff);
+            float factor = shape * splats[s].strength;
+            velocity += splats[s].force * factor;
+            changed = true;
+        }
+    }
+    if (changed) {
+        imageStore(velocityField, pos, vec4(velocity, 0.0, 0.0));
+    }
 }
 )";
 
@@ -82,10 +117,12 @@ layout(local_size_x = 16, local_size_y = 16) in;
 layout(rg32f, binding = 0) uniform image2D velocityOut;
 layout(rg32f, binding = 1) uniform image2D velocityIn;
 layout(rg32f, binding = 2) uniform image2D velocityBefore;
+layout(r32f, binding = 3) uniform image2D change;
 
 uniform int width;
 uniform int height;
 uniform float alpha;
+uniform int writeChange;   // 1: also store max(|du|, |dv|) of this update into change, for residual checks
 
 void main() {
     ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
@@ -108,6 +145,10 @@ void main() {
     vec2 result = (vC + alpha * (vL + vR + vU + vD)) / (1.0 + 4.0 * alpha);
 
     imageStore(velocityOut, pos, vec4(result, 0.0, 1.0));
+    if (writeChange != 0) {
+        vec2 update = abs(result - imageLoad(velocityIn, pos).xy);
+        imageStore(change, pos, vec4(max(update.x, update.y), 0.0, 0.0, 1.0));
+    }
 }
 )";
 
@@ -267,11 +308,12 @@ void main() {
 }
 )";
 
-const std::string ShaderManager::VISUALIZATION_SHADER_SOURCE = R"(
+const std::string ShaderManager::MULTIGRID_RESIDUAL_SHADER_SOURCE = R"(
 #version 430
 layout(local_size_x = 16, local_size_y = 16) in;
-layout(rg32f, binding = 0) uniform image2D velocityField;
-layout(rgba8, binding = 1) uniform image2D outputImage;
+layout(r32f, binding = 0) uniform image2D pressureField;
+layout(r32f, binding = 1) uniform image2D rhsField;
+layout(r32f, binding = 2) uniform image2D residualOut;
 
 uniform int width;
 uniform int height;
@@ -280,12 +322,178 @@ void main() {
     ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
     if (pos.x >= width || pos.y >= height) return;
 
-    vec2 velocity = imageLoad(velocityField, pos).xy;
-    float magnitude = length(velocity);
+    ivec2 left = ivec2(max(pos.x - 1, 0), pos.y);
+    ivec2 right = ivec2(min(pos.x + 1, width-1), pos.y);
+    ivec2 up = ivec2(pos.x, max(pos.y - 1, 0));
+    ivec2 down = ivec2(pos.x, min(pos.y + 1, height-1));
+
+    float p = imageLoad(pressureField, pos).x;
+    float neighbours = imageLoad(pressureField, left).x + imageLoad(pressureField, right).x +
+                       imageLoad(pressureField, up).x + imageLoad(pressureField, down).x;
+
+    // Residual of 4p - (pL + pR + pU + pD) = rhs
+    float r = imageLoad(rhsField, pos).x - (4.0 * p - neighbours);
+    imageStore(residualOut, pos, vec4(r, 0.0, 0.0, 1.0));
+}
+)";
+
+const std::string ShaderManager::MULTIGRID_RESTRICT_SHADER_SOURCE = R"(
+#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(r32f, binding = 0) uniform image2D fineResidual;
+layout(r32f, binding = 1) uniform image2D coarseRhs;
+layout(r32f, binding = 2) uniform image2D coarsePressure;
+
+uniform int width;        // coarse level
+uniform int height;
+uniform int fineWidth;
+uniform int fineHeight;
 
-    // Map velocity magnitude to color
-    vec3 color = vec3(magnitude / 5.0);
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (pos.x >= width || pos.y >= height) return;
 
-    imageStore(outputImage, pos, vec4(color, 1.0));
+    // Sum of the 2x2 children: their average, rescaled for the doubled grid spacing
+    ivec2 child = pos * 2;
+    float sum = 0.0;
+    for (int dy = 0; dy < 2; dy++) {
+        for (int dx = 0; dx < 2; dx++) {
+            ivec2 c = child + ivec2(dx, dy);
+            if (c.x < fineWidth && c.y < fineHeight) {
+                sum += imageLoad(fineResidual, c).x;
+            }
+        }
+    }
+
+    imageStore(coarseRhs, pos, vec4(sum, 0.0, 0.0, 1.0));
+    // The coarse correction starts from zero on every visit
+    imageStore(coarsePressure, pos, vec4(0.0));
 }
-)";
\ No newline at end of file
+)";
+
+const std::string ShaderManager::MULTIGRID_PROLONG_SHADER_SOURCE = R"(
+#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(r32f, binding = 0) uniform image2D coarsePressure;
+layout(r32f, binding = 1) uniform image2D finePressure;
+
+uniform int width;        // fine level
+uniform int height;
+uniform int coarseWidth;
+uniform int coarseHeight;
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (pos.x >= width || pos.y >= height) return;
+
+    // Bilinear interpolation from the parent and its neighbours on this cell's side
+    ivec2 parent = pos / 2;
+    ivec2 side = ivec2((pos.x % 2 == 0) ? -1 : 1, (pos.y % 2 == 0) ? -1 : 1);
+    ivec2 other = clamp(parent + side, ivec2(0), ivec2(coarseWidth - 1, coarseHeight - 1));
+
+    float near = imageLoad(coarsePressure, parent).x;
+    float alongX = imageLoad(coarsePressure, ivec2(other.x, parent.y)).x;
+    float alongY = imageLoad(coarsePressure, ivec2(parent.x, other.y)).x;
+    float diagonal = imageLoad(coarsePressure, other).x;
+    float correction = (9.0 * near + 3.0 * alongX + 3.0 * alongY + diagonal) / 16.0;
+
+    float p = imageLoad(finePressure, pos).x + correction;
+    imageStore(finePressure, pos, vec4(p, 0.0, 0.0, 1.0));
+}
+)";
+
+// Field reductions (gpu_reduction.hpp). Each pass reduces 256 values per work group in shared
+// memory and writes one (x, y) partial per group: x = sum for the sum ops, and (min, max) for
+// the extremum ops. Groups combine in a fixed order, so sums are the same on every run.
+const std::string ShaderManager::REDUCTION_FIELD_SHADER_SOURCE = R"(
+#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(binding = 0) uniform sampler2D field;
+
+layout(std430, binding = 1) writeonly buffer Partials {
+    vec2 partialsOut[];
+};
+
+uniform int width;
+uniform int height;
+uniform int components;   // 2: the value of a cell is the length of its vector
+uniform int op;           // 0 = sum, 1 = sum of squares, 2 = min and max
+
+shared vec2 partial[256];
+
+vec2 combine(vec2 a, vec2 b) {
+    if (op == 2) return vec2(min(a.x, b.x), max(a.y, b.y));
+    return vec2(a.x + b.x, 0.0);
+}
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    uint local = gl_LocalInvocationIndex;
+
+    // Out-of-range invocations hold the identity and still take part in the barriers
+    float infinity = uintBitsToFloat(0x7f800000u);
+    vec2 value = op == 2 ? vec2(infinity, -infinity) : vec2(0.0);
+    if (pos.x < width && pos.y < height) {
+        vec2 cell = texelFetch(field, pos, 0).xy;
+        float v = components == 2 ? length(cell) : cell.x;
+        if (op == 0) value = vec2(v, 0.0);
+        else if (op == 1) value = vec2(v * v, 0.0);
+        else value = vec2(v, v);
+    }
+    partial[local] = value;
+    barrier();
+
+    for (uint stride = 128u; stride > 0u; stride >>= 1) {
+        if (local < stride) {
+            partial[local] = combine(partial[local], partial[local + stride]);
+        }
+        barrier();
+    }
+
+    if (local == 0u) {
+        partialsOut[gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x] = partial[0];
+    }
+}
+)";
+
+const std::string ShaderManager::REDUCTION_PARTIALS_SHADER_SOURCE = R"(
+#version 430
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) readonly buffer PartialsIn {
+    vec2 partialsIn[];
+};
+layout(std430, binding = 1) writeonly buffer PartialsOut {
+    vec2 partialsOut[];
+};
+
+uniform int count;
+uniform int op;
+
+shared vec2 partial[256];
+
+vec2 combine(vec2 a, vec2 b) {
+    if (op == 2) return vec2(min(a.x, b.x), max(a.y, b.y));
+    return vec2(a.x + b.x, 0.0);
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    uint local = gl_LocalInvocationIndex;
+
+    float infinity = uintBitsToFloat(0x7f800000u);
+    partial[local] = index < uint(count) ? partialsIn[index] : (op == 2 ? vec2(infinity, -infinity) : vec2(0.0));
+    barrier();
+
+    for (uint stride = 128u; stride > 0u; stride >>= 1) {
+        if (local < stride) {
+            partial[local] = combine(partial[local], partial[local + stride]);
+        }
+        barrier();
+    }
+
+    if (local == 0u) {
+        partialsOut[gl_WorkGroupID.x] = partial[0];
+    }
+}
+)";
@@ -54,5 +54,9 @@ public:
     static const std::string PROJECTION_SHADER_SOURCE;
     static const std::string PROJECTION_GRADIENT_SHADER_SOURCE;
     static const std::string BOUNDARY_SHADER_SOURCE;
-    static const std::string VISUALIZATION_SHADER_SOURCE;
+    static const std::string MULTIGRID_RESIDUAL_SHADER_SOURCE;
+    static const std::string MULTIGRID_RESTRICT_SHADER_SOURCE;
+    static const std::string MULTIGRID_PROLONG_SHADER_SOURCE;
+    static const std::string REDUCTION_FIELD_SHADER_SOURCE;
+    static const std::string REDUCTION_PARTIALS_SHADER_SOURCE;
 };
\ No newline at end of file
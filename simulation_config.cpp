@@ -0,0 +1,273 @@
+#include "simulation_config.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+bool parseInt(const std::string& text, int& value) {
+    char* end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno != 0 || parsed < -2147483647L || parsed > 2147483647L) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parseDouble(const std::string& text, double& value) {
+    char* end = nullptr;
+    errno = 0;
+    double parsed = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || errno != 0) return false;
+    value = parsed;
+    return true;
+}
+
+namespace {
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+const char* boundaryName(BoundaryCondition condition) {
+    switch (condition) {
+        case BoundaryCondition::Zero: return "zero";
+        case BoundaryCondition::Periodic: return "periodic";
+        case BoundaryCondition::Antisymmetric: return "antisymmetric";
+        case BoundaryCondition::Clamp:
+        default: return "clamp";
+    }
+}
+
+const char* solverName(PressureSolver solver) {
+    switch (solver) {
+        case PressureSolver::Multigrid: return "multigrid";
+        case PressureSolver::ConjugateGradient: return "cg";
+        case PressureSolver::GaussSeidel:
+        default: return "gauss-seidel";
+    }
+}
+
+const char* preconditionerName(Preconditioner preconditioner) {
+    switch (preconditioner) {
+        case Preconditioner::IncompleteCholesky: return "ic";
+        case Preconditioner::Multigrid: return "multigrid";
+        case Preconditioner::Jacobi:
+        default: return "jacobi";
+    }
+}
+
+}
+
+SimulationConfig SimulationConfig::gpuDefaults() {
+    SimulationConfig config;
+    config.width = 512;
+    config.height = 512;
+    config.timeStep = 0.2;
+    config.viscosity = 30;
+    config.diffusionIterations = 15;
+    config.projectionIterations = 20;
+    return config;
+}
+
+bool SimulationConfig::set(const std::string& key, const std::string& value) {
+    bool ok = true;
+    if (key == "width") ok = parseInt(value, width);
+    else if (key == "height") ok = parseInt(value, height);
+    else if (key == "time-step") ok = parseDouble(value, timeStep);
+    else if (key == "viscosity") ok = parseDouble(value, viscosity);
+    else if (key == "dx") ok = parseDouble(value, dx);
+    else if (key == "diffusion-iterations") ok = parseInt(value, diffusionIterations);
+    else if (key == "projection-iterations") ok = parseInt(value, projectionIterations);
+    else if (key == "diffusion-tol") ok = parseDouble(value, diffusionTolerance);
+    else if (key == "projection-tol" || key == "pressure-tol") ok = parseDouble(value, projectionTolerance);
+    else if (key == "check-every") ok = parseInt(value, residualCheckInterval);
+    else if (key == "cg-tol") ok = parseDouble(value, cgTolerance);
+    else if (key == "cg-max-iterations") ok = parseInt(value, cgMaxIterations);
+    else if (key == "temporal-block") ok = parseInt(value, diffusionBlockDepth);
+    else if (key == "tile-rows") ok = parseInt(value, diffusionTileRows);
+    else if (key == "multigrid-cycles") ok = parseInt(value, multigridCycles);
+    else if (key == "precision") {
+        if (value == "float") precision = Precision::Float;
+        else if (value == "double") precision = Precision::Double;
+        else ok = false;
+    }
+    else if (key == "boundary") {
+        if (value == "clamp") boundaryCondition = BoundaryCondition::Clamp;
+        else if (value == "zero") boundaryCondition = BoundaryCondition::Zero;
+        else if (value == "periodic") boundaryCondition = BoundaryCondition::Periodic;
+        else if (value == "antisymmetric") boundaryCondition = BoundaryCondition::Antisymmetric;
+        else ok = false;
+    }
+    else if (key == "pressure-solver") {
+        if (value == "gauss-seidel") pressureSolver = PressureSolver::GaussSeidel;
+        else if (value == "multigrid") pressureSolver = PressureSolver::Multigrid;
+        else if (value == "cg") pressureSolver = PressureSolver::ConjugateGradient;
+        else ok = false;
+    }
+    else if (key == "multigrid-cycle") {
+        if (value == "v") multigridCycle = MultigridCycle::V;
+        else if (value == "w") multigridCycle = MultigridCycle::W;
+        else ok = false;
+    }
+    else if (key == "preconditioner") {
+        if (value == "jacobi") preconditioner = Preconditioner::Jacobi;
+        else if (value == "ic") preconditioner = Preconditioner::IncompleteCholesky;
+        else if (value == "multigrid") preconditioner = Preconditioner::Multigrid;
+        else ok = false;
+    }
+    else {
+        std::cerr << "Unknown option: " << key << std::endl;
+        return false;
+    }
+
+    if (!ok) {
+        std::cerr << "Invalid value for " << key << ": " << value << std::endl;
+    }
+    return ok;
+}
+
+bool SimulationConfig::loadFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open config file: " << path << std::endl;
+        return false;
+    }
+    return parse(file, path);
+}
+
+bool SimulationConfig::parse(std::istream& in, const std::string& source) {
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << source << ":" << lineNumber << ": expected key = value" << std::endl;
+            return false;
+        }
+        if (!set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)))) {
+            std::cerr << source << ":" << lineNumber << ": rejected" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SimulationConfig::parseArguments(int argc, char** argv, std::vector<std::string>& positional) {
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        if (arg.compare(0, 2, "--") != 0) {
+            positional.push_back(arg);
+            continue;
+        }
+
+        std::string key = arg.substr(2);
+        if (key == "multigrid" || key == "multigrid-w") {
+            pressureSolver = PressureSolver::Multigrid;
+            multigridCycle = (key == "multigrid-w") ? MultigridCycle::W : MultigridCycle::V;
+            continue;
+        }
+        if (key == "cg" || key == "cg-ic" || key == "cg-mg") {
+            pressureSolver = PressureSolver::ConjugateGradient;
+            preconditioner = (key == "cg-ic") ? Preconditioner::IncompleteCholesky
+                           : (key == "cg-mg") ? Preconditioner::Multigrid
+                           : Preconditioner::Jacobi;
+            continue;
+        }
+
+        std::string value;
+        size_t equals = key.find('=');
+        if (equals != std::string::npos) {
+            value = key.substr(equals + 1);
+            key = key.substr(0, equals);
+        } else if (a + 1 < argc) {
+            value = argv[++a];
+        } else {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+
+        bool ok = (key == "config") ? loadFile(value) : set(key, value);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool SimulationConfig::validate() const {
+    bool ok = true;
+    if (width < 2 || height < 2) {
+        std::cerr << "Grid must be at least 2x2, got " << width << "x" << height << std::endl;
+        ok = false;
+    }
+    if (!(timeStep > 0) || !(dx > 0) || viscosity < 0) {
+        std::cerr << "time-step and dx must be positive and viscosity non-negative" << std::endl;
+        ok = false;
+    }
+    if (diffusionIterations < 0 || projectionIterations < 0 || multigridCycles < 1 || residualCheckInterval < 1 || cgMaxIterations < 1) {
+        std::cerr << "Iteration counts must be non-negative, multigrid-cycles, check-every and cg-max-iterations at least 1" << std::endl;
+        ok = false;
+    }
+    if (diffusionBlockDepth < 1 || diffusionTileRows < 1) {
+        std::cerr << "temporal-block and tile-rows must be at least 1" << std::endl;
+        ok = false;
+    }
+    if (diffusionTolerance < 0 || projectionTolerance < 0 || cgTolerance < 0) {
+        std::cerr << "Tolerances must be non-negative" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+void SimulationConfig::print(std::ostream& out) const {
+    out << "Grid Size: " << width << "x" << height << std::endl;
+    out << "Precision: " << precisionName(precision) << std::endl;
+    out << "Time step: " << timeStep << ", viscosity: " << viscosity << ", dx: " << dx << std::endl;
+    out << "Diffusion: " << diffusionIterations << " iterations, tolerance " << diffusionTolerance;
+    if (diffusionBlockDepth > 1) {
+        out << ", " << diffusionBlockDepth << " per tile of " << diffusionTileRows << " rows";
+    }
+    out << std::endl;
+    out << "Pressure: " << solverName(pressureSolver);
+    if (pressureSolver == PressureSolver::Multigrid) {
+        out << " (" << multigridCycles << (multigridCycle == MultigridCycle::W ? " W" : " V") << "-cycles)";
+    } else if (pressureSolver == PressureSolver::ConjugateGradient) {
+        out << " (" << preconditionerName(preconditioner) << ", tolerance " << cgTolerance
+            << ", at most " << cgMaxIterations << " iterations)";
+    } else {
+        out << " (" << projectionIterations << " iterations, tolerance " << projectionTolerance << ")";
+    }
+    out << ", boundary: " << boundaryName(boundaryCondition) << std::endl;
+}
+
+void SimulationConfig::save(std::ostream& out) const {
+    // enough digits that every double reads back to the same bits
+    std::streamsize oldPrecision = out.precision(std::numeric_limits<double>::max_digits10);
+    out << "width = " << width << "\n";
+    out << "height = " << height << "\n";
+    out << "time-step = " << timeStep << "\n";
+    out << "viscosity = " << viscosity << "\n";
+    out << "dx = " << dx << "\n";
+    out << "diffusion-iterations = " << diffusionIterations << "\n";
+    out << "projection-iterations = " << projectionIterations << "\n";
+    out << "diffusion-tol = " << diffusionTolerance << "\n";
+    out << "projection-tol = " << projectionTolerance << "\n";
+    out << "check-every = " << residualCheckInterval << "\n";
+    out << "cg-tol = " << cgTolerance << "\n";
+    out << "cg-max-iterations = " << cgMaxIterations << "\n";
+    out << "temporal-block = " << diffusionBlockDepth << "\n";
+    out << "tile-rows = " << diffusionTileRows << "\n";
+    out << "precision = " << precisionName(precision) << "\n";
+    out << "boundary = " << boundaryName(boundaryCondition) << "\n";
+    out << "pressure-solver = " << solverName(pressureSolver) << "\n";
+    out << "multigrid-cycle = " << (multigridCycle == MultigridCycle::W ? "w" : "v") << "\n";
+    out << "multigrid-cycles = " << multigridCycles << "\n";
+    out << "preconditioner = " << preconditionerName(preconditioner) << "\n";
+    out.precision(oldPrecision);
+}
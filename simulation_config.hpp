@@ -0,0 +1,81 @@
+#ifndef SIMULATION_CONFIG_HPP
+#define SIMULATION_CONFIG_HPP
+
+#include "field2d.hpp"
+#include "multigrid.hpp"
+#include "pcg.hpp"
+#include "pressure_solver.hpp"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Grid size, physical constants and solver settings shared by the CPU grid and GPUSolver.
+// Every field can be set by name, from a config file or the command line:
+//   width = 512           (file: one key = value per line, # starts a comment)
+//   --width 512           (command line; --width=512 works too)
+//   --config sweep.cfg    (loads a file in place, so later options override it)
+// Solver switches: --multigrid, --multigrid-w, --cg, --cg-ic, --cg-mg.
+struct SimulationConfig {
+    int width = 256;
+    int height = 256;
+    double timeStep = 0.5;
+    double viscosity = 0.1;
+    double dx = 1;
+
+    int diffusionIterations = 50;
+    int projectionIterations = 20;
+    double diffusionTolerance = 0;    // 0 runs every iteration
+    double projectionTolerance = 0;
+    int residualCheckInterval = 5;
+
+    // Conjugate gradient stops at a relative residual ||b - Ap|| / ||b|| of cgTolerance, or
+    // after cgMaxIterations
+    double cgTolerance = 1e-4;
+    int cgMaxIterations = 500;
+
+    // Temporal blocking for the CPU diffusion sweeps: runs this many Jacobi iterations per
+    // cache-resident tile of diffusionTileRows rows. 1 sweeps the whole field each iteration.
+    int diffusionBlockDepth = 1;
+    int diffusionTileRows = 32;
+
+    // scalar type of the CPU grid's fields and of the frames it writes; the GPU always uses float
+    Precision precision = Precision::Double;
+
+    BoundaryCondition boundaryCondition = BoundaryCondition::Clamp;
+    PressureSolver pressureSolver = PressureSolver::GaussSeidel;
+    MultigridCycle multigridCycle = MultigridCycle::V;
+    int multigridCycles = 2;
+    Preconditioner preconditioner = Preconditioner::Jacobi;
+
+    // Values the GPU solver was tuned with: 512x512, dt 0.2, viscosity 30, 15 diffusion sweeps
+    static SimulationConfig gpuDefaults();
+
+    // Sets one field by its option name (without the dashes). Prints the problem and returns
+    // false for an unknown key or a value that does not parse.
+    bool set(const std::string& key, const std::string& value);
+
+    bool loadFile(const std::string& path);
+
+    // Reads key = value lines like loadFile; source names the text in messages
+    bool parse(std::istream& in, const std::string& source);
+
+    // Writes every field as key = value lines that parse() reads back to this exact config
+    void save(std::ostream& out) const;
+
+    // Applies every option in argv[1..]; arguments that are not options are appended to
+    // positional in order
+    bool parseArguments(int argc, char** argv, std::vector<std::string>& positional);
+
+    // Rejects sizes and counts the solvers cannot run with
+    bool validate() const;
+
+    void print(std::ostream& out) const;
+};
+
+// Number parsing for option values that never throws: false, leaving value alone, unless all
+// of text is a number in range
+bool parseInt(const std::string& text, int& value);
+bool parseDouble(const std::string& text, double& value);
+
+#endif // SIMULATION_CONFIG_HPP
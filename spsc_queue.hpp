@@ -0,0 +1,131 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer single-consumer queue. Neither side ever locks: the producer owns
+// tail and the consumer head, each only reads the other's, so one thread can push while
+// another pops. Each index sits on its own cache line, so the two sides do not contend.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(std::size_t capacity = 1) { reset(capacity); }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Empties the queue and sets its capacity; neither side may be running
+    void reset(std::size_t capacity) {
+        slots.assign(std::max<std::size_t>(1, capacity), T());
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    // False, without waiting, when the queue is full
+    bool tryPush(const T& item) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size()) return false;
+        slots[t % slots.size()] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // False, without waiting, when the queue is empty
+    bool tryPop(T& item) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = slots[h % slots.size()];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Items queued; exact on either side's thread while the other is idle, a snapshot otherwise
+    std::size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+    std::size_t capacity() const { return slots.size(); }
+
+private:
+    std::vector<T> slots;
+    alignas(64) std::atomic<std::size_t> head{ 0 };     // next to pop, written by the consumer
+    alignas(64) std::atomic<std::size_t> tail{ 0 };     // next to push, written by the producer
+};
+
+// Waits until ready() holds: spins briefly, then yields, then sleeps in short naps, so a
+// stage that waits long costs next to no CPU. Returns the seconds spent waiting.
+template <typename Ready>
+double waitUntil(Ready&& ready) {
+    if (ready()) return 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int attempt = 0; !ready(); attempt++) {
+        if (attempt < 64) continue;
+        if (attempt < 256) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// What a pipeline stage has done so far, as read by stats()
+struct StageStats {
+    const char* name = "";
+    long items = 0;
+    double busySeconds = 0;       // working on items
+    double waitSeconds = 0;       // waiting for input or for room downstream
+    double meanQueueDepth = 0;    // items waiting in its input queue when it took one
+    long maxQueueDepth = 0;
+
+    double itemsPerSecond() const { return busySeconds > 0 ? items / busySeconds : 0; }
+};
+
+// A stage's counters, written by the stage's thread and readable from any other while it runs
+class StageCounters {
+public:
+    void addItem() { items.fetch_add(1, std::memory_order_relaxed); }
+    void addBusy(double seconds) { busyNanoseconds.fetch_add(toNanoseconds(seconds), std::memory_order_relaxed); }
+    void addWait(double seconds) { waitNanoseconds.fetch_add(toNanoseconds(seconds), std::memory_order_relaxed); }
+
+    void sampleQueueDepth(std::size_t depth) {
+        depthSamples.fetch_add(1, std::memory_order_relaxed);
+        depthSum.fetch_add(static_cast<long>(depth), std::memory_order_relaxed);
+        if (static_cast<long>(depth) > maxDepth.load(std::memory_order_relaxed)) {
+            maxDepth.store(static_cast<long>(depth), std::memory_order_relaxed);
+        }
+    }
+
+    void reset() {
+        items = 0;
+        busyNanoseconds = 0;
+        waitNanoseconds = 0;
+        depthSamples = 0;
+        depthSum = 0;
+        maxDepth = 0;
+    }
+
+    StageStats stats(const char* name) const {
+        StageStats s;
+        s.name = name;
+        s.items = items.load(std::memory_order_relaxed);
+        s.busySeconds = busyNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        s.waitSeconds = waitNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+        long samples = depthSamples.load(std::memory_order_relaxed);
+        s.meanQueueDepth = samples > 0 ? double(depthSum.load(std::memory_order_relaxed)) / samples : 0;
+        s.maxQueueDepth = maxDepth.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    static std::int64_t toNanoseconds(double seconds) { return static_cast<std::int64_t>(seconds * 1e9); }
+
+    std::atomic<long> items{ 0 };
+    std::atomic<std::int64_t> busyNanoseconds{ 0 };
+    std::atomic<std::int64_t> waitNanoseconds{ 0 };
+    std::atomic<long> depthSamples{ 0 };
+    std::atomic<long> depthSum{ 0 };
+    std::atomic<long> maxDepth{ 0 };
+};
+
+#endif // SPSC_QUEUE_HPP
@@ -0,0 +1,168 @@
+#include "stencil_kernels.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define STENCIL_X86 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define STENCIL_X86 1
+#endif
+
+namespace {
+
+template <typename Real, int Width>
+void jacobiRow(Real* out, const Real* before, const Real* up, const Real* mid,
+               const Real* down, int columns, Real alpha, Real denominator) {
+    const int n = Width > 0 ? Width : columns;
+    for (int j = 0; j < n; j++) {
+        out[j] = (before[j] + alpha * (up[j] + down[j] + mid[j - 1] + mid[j + 1])) / denominator;
+    }
+}
+
+template <typename Real, int Width>
+void redBlackRow(Real* p, const Real* up, const Real* down, const Real* div, int columns, int firstColumn) {
+    const int n = Width > 0 ? Width : columns;
+    for (int j = firstColumn; j < n; j += 2) {
+        p[j] = (div[j] + p[j + 1] + p[j - 1] + up[j] + down[j]) / 4;
+    }
+}
+
+template <typename Real, int Width>
+void divergenceRow(Real* div, const Real* u, const Real* vUp, const Real* vDown, int columns) {
+    const int n = Width > 0 ? Width : columns;
+    for (int j = 0; j < n; j++) {
+        div[j] = Real(-0.5) * ((u[j + 1] - u[j - 1]) + (vUp[j] - vDown[j]));
+    }
+}
+
+template <typename Real, int Width>
+void gradientRow(Real* u, Real* v, const Real* pUp, const Real* p, const Real* pDown, int columns) {
+    const int n = Width > 0 ? Width : columns;
+    for (int j = 0; j < n; j++) {
+        Real xGradient = (p[j + 1] - p[j - 1]) / 2;
+        Real yGradient = (pUp[j] - pDown[j]) / 2;
+        u[j] -= xGradient;
+        v[j] -= yGradient;
+    }
+}
+
+template <typename Real>
+void blendRow(Real* out, const Real* from, const Real* to, int n, Real fromWeight, Real toWeight, Real denominator) {
+    for (int j = 0; j < n; j++) {
+        out[j] = (from[j] * fromWeight + to[j] * toWeight) / denominator;
+    }
+}
+
+template <typename Real, int Width>
+struct ScalarKernels {
+    static constexpr StencilKernels<Real> set = { "scalar", Width, jacobiRow<Real, Width>, redBlackRow<Real, Width>,
+                                                  divergenceRow<Real, Width>, gradientRow<Real, Width>,
+                                                  blendRow<Real> };
+};
+
+#ifdef STENCIL_X86
+void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int k = 0; k < 4; k++) regs[k] = static_cast<unsigned>(info[k]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switch (XCR0)
+unsigned long long enabledRegisterState() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+}
+#endif
+
+SimdLevel detectCpu() {
+#ifdef STENCIL_X86
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+
+    cpuid(1, 0, regs);
+    bool sse2 = (regs[3] >> 26) & 1;
+    bool osxsave = (regs[2] >> 27) & 1;
+    if (!sse2) return SimdLevel::Scalar;
+    if (!osxsave || maxLeaf < 7) return SimdLevel::SSE2;
+
+    unsigned long long xcr0 = enabledRegisterState();
+    bool ymmState = (xcr0 & 0x6) == 0x6;
+    bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+    cpuid(7, 0, regs);
+    bool avx2 = (regs[1] >> 5) & 1;
+    bool avx512f = (regs[1] >> 16) & 1;
+
+    if (avx512f && zmmState) return SimdLevel::AVX512;
+    if (avx2 && ymmState) return SimdLevel::AVX2;
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+template <typename Real>
+const StencilKernels<Real>* kernelsForLevel(SimdLevel level, int width) {
+    switch (level) {
+        case SimdLevel::AVX512: return avx512StencilKernels<Real>(width);
+        case SimdLevel::AVX2: return avx2StencilKernels<Real>(width);
+        case SimdLevel::SSE2: return sse2StencilKernels<Real>(width);
+        case SimdLevel::Scalar:
+        default: return &scalarStencilKernels<Real>(width);
+    }
+}
+
+}
+
+template <typename Real>
+const StencilKernels<Real>& scalarStencilKernels(int width) {
+    return kernelsForWidth<Real, ScalarKernels>(width);
+}
+
+SimdLevel detectSimdLevel() {
+    static const SimdLevel detected = [] {
+        SimdLevel level = detectCpu();
+        while (level != SimdLevel::Scalar && kernelsForLevel<double>(level, 0) == nullptr) {
+            level = static_cast<SimdLevel>(static_cast<int>(level) - 1);
+        }
+        return level;
+    }();
+    return detected;
+}
+
+template <typename Real>
+const StencilKernels<Real>& stencilKernels(SimdLevel level, int width) {
+    // never hand out instructions the running CPU lacks
+    if (static_cast<int>(level) > static_cast<int>(detectSimdLevel())) {
+        level = detectSimdLevel();
+    }
+    while (level != SimdLevel::Scalar && kernelsForLevel<Real>(level, width) == nullptr) {
+        level = static_cast<SimdLevel>(static_cast<int>(level) - 1);
+    }
+    return *kernelsForLevel<Real>(level, width);
+}
+
+template const StencilKernels<float>& scalarStencilKernels<float>(int);
+template const StencilKernels<double>& scalarStencilKernels<double>(int);
+template const StencilKernels<float>& stencilKernels<float>(SimdLevel, int);
+template const StencilKernels<double>& stencilKernels<double>(SimdLevel, int);
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX512: return "AVX-512";
+        case SimdLevel::AVX2: return "AVX2";
+        case SimdLevel::SSE2: return "SSE2";
+        case SimdLevel::Scalar:
+        default: return "scalar";
+    }
+}
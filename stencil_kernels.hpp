@@ -0,0 +1,85 @@
+#ifndef STENCIL_KERNELS_HPP
+#define STENCIL_KERNELS_HPP
+
+// Row kernels behind the CPU grid sweeps, for float or double fields. Each pointer addresses
+// column 0 of a row of n cells; reads at column -1 and n land in the field's halo. The scalar
+// set is the reference; the SIMD sets perform the same operations in the same order.
+template <typename Real>
+struct StencilKernels {
+    const char* name;
+
+    // 0 for kernels that take the row length from n. Otherwise the set is specialised for
+    // rows of exactly this many cells, and n is ignored.
+    int width;
+
+    // Diffusion Jacobi update:
+    // out[j] = (before[j] + alpha * (up[j] + down[j] + mid[j - 1] + mid[j + 1])) / denominator
+    void (*jacobiRow)(Real* out, const Real* before, const Real* up, const Real* mid,
+                      const Real* down, int n, Real alpha, Real denominator);
+
+    // Red-black Gauss-Seidel update of every other cell, starting at column firstColumn (0 or 1):
+    // p[j] = (div[j] + p[j + 1] + p[j - 1] + up[j] + down[j]) / 4
+    void (*redBlackRow)(Real* p, const Real* up, const Real* down, const Real* div,
+                        int n, int firstColumn);
+
+    // div[j] = -0.5 * ((u[j + 1] - u[j - 1]) + (vUp[j] - vDown[j]))
+    void (*divergenceRow)(Real* div, const Real* u, const Real* vUp, const Real* vDown, int n);
+
+    // u[j] -= (p[j + 1] - p[j - 1]) / 2, v[j] -= (pUp[j] - pDown[j]) / 2
+    void (*gradientRow)(Real* u, Real* v, const Real* pUp, const Real* p, const Real* pDown, int n);
+
+    // Linear blend of two frames' values, for the in-betweens:
+    // out[j] = (from[j] * fromWeight + to[j] * toWeight) / denominator
+    // It reads no halo and always takes the length from n, as frames are blended whole.
+    void (*blendRow)(Real* out, const Real* from, const Real* to, int n, Real fromWeight, Real toWeight,
+                     Real denominator);
+};
+
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+// Best level supported by both this build and the running CPU, read from cpuid once
+SimdLevel detectSimdLevel();
+
+// Kernel set for a level, capped at detectSimdLevel() and falling back to the next lower
+// level this build provides. With a width from kernelsForWidth() the set is specialised
+// for that row length; other widths, and 0, give the set that takes any n.
+template <typename Real>
+const StencilKernels<Real>& stencilKernels(SimdLevel level, int width = 0);
+
+const char* simdLevelName(SimdLevel level);
+
+// Per-ISA kernel sets, each compiled in its own translation unit with the matching
+// instruction-set flags. They return nullptr when the build could not target that ISA.
+// All of them are instantiated for float and double.
+template <typename Real>
+const StencilKernels<Real>& scalarStencilKernels(int width = 0);
+template <typename Real>
+const StencilKernels<Real>* sse2StencilKernels(int width = 0);
+template <typename Real>
+const StencilKernels<Real>* avx2StencilKernels(int width = 0);
+template <typename Real>
+const StencilKernels<Real>* avx512StencilKernels(int width = 0);
+
+// Each kernel translation unit instantiates its row functions once per power-of-two width
+// below, plus once with Width = 0 for any other length. A fixed row length is a constant
+// loop bound, so the compiler can unroll the vector loop and drop the remainder.
+// Set<Real, Width>::set is the kernel set instantiated for Width.
+template <typename Real, template <typename, int> class Set>
+const StencilKernels<Real>& kernelsForWidth(int width) {
+    switch (width) {
+        case 64: return Set<Real, 64>::set;
+        case 128: return Set<Real, 128>::set;
+        case 256: return Set<Real, 256>::set;
+        case 512: return Set<Real, 512>::set;
+        case 1024: return Set<Real, 1024>::set;
+        case 2048: return Set<Real, 2048>::set;
+        default: return Set<Real, 0>::set;
+    }
+}
+
+#endif // STENCIL_KERNELS_HPP
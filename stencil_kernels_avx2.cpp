@@ -0,0 +1,78 @@
+#include "stencil_kernels.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#include "stencil_kernels_simd.hpp"
+
+namespace {
+
+// Four doubles or eight floats per register
+
+template <typename Real>
+struct Ops;
+
+template <>
+struct Ops<double> {
+    using Scalar = double;
+    using Vector = __m256d;
+    using Mask = __m256d;
+    static constexpr int lanes = 4;
+    static Vector set1(double x) { return _mm256_set1_pd(x); }
+    static Vector load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, Vector x) { _mm256_storeu_pd(p, x); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm256_div_pd(a, b); }
+    static Mask colourMask(int firstColumn) {
+        return firstColumn == 0
+            ? _mm256_castsi256_pd(_mm256_set_epi64x(0, -1, 0, -1))
+            : _mm256_castsi256_pd(_mm256_set_epi64x(-1, 0, -1, 0));
+    }
+    static Vector blend(Mask mask, Vector old, Vector updated) { return _mm256_blendv_pd(old, updated, mask); }
+};
+
+template <>
+struct Ops<float> {
+    using Scalar = float;
+    using Vector = __m256;
+    using Mask = __m256;
+    static constexpr int lanes = 8;
+    static Vector set1(float x) { return _mm256_set1_ps(x); }
+    static Vector load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Vector x) { _mm256_storeu_ps(p, x); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm256_div_ps(a, b); }
+    static Mask colourMask(int firstColumn) {
+        return firstColumn == 0
+            ? _mm256_castsi256_ps(_mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1))
+            : _mm256_castsi256_ps(_mm256_set_epi32(-1, 0, -1, 0, -1, 0, -1, 0));
+    }
+    static Vector blend(Mask mask, Vector old, Vector updated) { return _mm256_blendv_ps(old, updated, mask); }
+};
+
+template <typename Real, int Width>
+struct Avx2Kernels {
+    static constexpr StencilKernels<Real> set = simdKernelSet<Ops<Real>, Width>("AVX2");
+};
+
+}
+
+template <typename Real>
+const StencilKernels<Real>* avx2StencilKernels(int width) {
+    return &kernelsForWidth<Real, Avx2Kernels>(width);
+}
+
+#else
+
+template <typename Real>
+const StencilKernels<Real>* avx2StencilKernels(int) {
+    return nullptr;
+}
+
+#endif
+
+template const StencilKernels<float>* avx2StencilKernels<float>(int);
+template const StencilKernels<double>* avx2StencilKernels<double>(int);
@@ -0,0 +1,70 @@
+#include "stencil_kernels.hpp"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#include "stencil_kernels_simd.hpp"
+
+namespace {
+
+// Eight doubles or sixteen floats per register
+
+template <typename Real>
+struct Ops;
+
+template <>
+struct Ops<double> {
+    using Scalar = double;
+    using Vector = __m512d;
+    using Mask = __mmask8;
+    static constexpr int lanes = 8;
+    static Vector set1(double x) { return _mm512_set1_pd(x); }
+    static Vector load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, Vector x) { _mm512_storeu_pd(p, x); }
+    static Vector add(Vector a, Vector b) { return _mm512_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm512_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm512_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm512_div_pd(a, b); }
+    static Mask colourMask(int firstColumn) { return firstColumn == 0 ? 0x55 : 0xAA; }
+    static Vector blend(Mask mask, Vector old, Vector updated) { return _mm512_mask_blend_pd(mask, old, updated); }
+};
+
+template <>
+struct Ops<float> {
+    using Scalar = float;
+    using Vector = __m512;
+    using Mask = __mmask16;
+    static constexpr int lanes = 16;
+    static Vector set1(float x) { return _mm512_set1_ps(x); }
+    static Vector load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, Vector x) { _mm512_storeu_ps(p, x); }
+    static Vector add(Vector a, Vector b) { return _mm512_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm512_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm512_mul_ps(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm512_div_ps(a, b); }
+    static Mask colourMask(int firstColumn) { return firstColumn == 0 ? 0x5555 : 0xAAAA; }
+    static Vector blend(Mask mask, Vector old, Vector updated) { return _mm512_mask_blend_ps(mask, old, updated); }
+};
+
+template <typename Real, int Width>
+struct Avx512Kernels {
+    static constexpr StencilKernels<Real> set = simdKernelSet<Ops<Real>, Width>("AVX-512");
+};
+
+}
+
+template <typename Real>
+const StencilKernels<Real>* avx512StencilKernels(int width) {
+    return &kernelsForWidth<Real, Avx512Kernels>(width);
+}
+
+#else
+
+template <typename Real>
+const StencilKernels<Real>* avx512StencilKernels(int) {
+    return nullptr;
+}
+
+#endif
+
+template const StencilKernels<float>* avx512StencilKernels<float>(int);
+template const StencilKernels<double>* avx512StencilKernels<double>(int);
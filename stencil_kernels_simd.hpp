@@ -0,0 +1,113 @@
+#ifndef STENCIL_KERNELS_SIMD_HPP
+#define STENCIL_KERNELS_SIMD_HPP
+
+#include "stencil_kernels.hpp"
+
+// Row kernels shared by the SIMD translation units. Each unit includes this after its
+// intrinsics header and instantiates the kernels with its own Ops type, which wraps one
+// register of Ops::Scalar: lanes, set1, load, store, add, sub, mul, div, plus colourMask and
+// blend for the red-black update. Every unit therefore compiles the same operation order for
+// its ISA. Leftover columns go through the scalar kernels.
+
+template <typename Ops, int Width>
+void simdJacobiRow(typename Ops::Scalar* out, const typename Ops::Scalar* before, const typename Ops::Scalar* up,
+                   const typename Ops::Scalar* mid, const typename Ops::Scalar* down, int columns,
+                   typename Ops::Scalar alpha, typename Ops::Scalar denominator) {
+    using Real = typename Ops::Scalar;
+    const int n = Width > 0 ? Width : columns;
+    const auto a = Ops::set1(alpha);
+    const auto d = Ops::set1(denominator);
+    int j = 0;
+    for (; j + Ops::lanes <= n; j += Ops::lanes) {
+        auto sum = Ops::add(Ops::load(up + j), Ops::load(down + j));
+        sum = Ops::add(sum, Ops::load(mid + j - 1));
+        sum = Ops::add(sum, Ops::load(mid + j + 1));
+        Ops::store(out + j, Ops::div(Ops::add(Ops::load(before + j), Ops::mul(a, sum)), d));
+    }
+    if (j < n) {
+        scalarStencilKernels<Real>().jacobiRow(out + j, before + j, up + j, mid + j, down + j, n - j, alpha, denominator);
+    }
+}
+
+// Every lane is computed and the other colour's lanes are blended back unchanged. Those
+// lanes are only read by this colour's update, so updating in place stays exact.
+template <typename Ops, int Width>
+void simdRedBlackRow(typename Ops::Scalar* p, const typename Ops::Scalar* up, const typename Ops::Scalar* down,
+                     const typename Ops::Scalar* div, int columns, int firstColumn) {
+    using Real = typename Ops::Scalar;
+    const int n = Width > 0 ? Width : columns;
+    const auto four = Ops::set1(Real(4));
+    const auto mask = Ops::colourMask(firstColumn);
+    int j = 0;
+    for (; j + Ops::lanes <= n; j += Ops::lanes) {
+        auto old = Ops::load(p + j);
+        auto sum = Ops::add(Ops::load(div + j), Ops::load(p + j + 1));
+        sum = Ops::add(sum, Ops::load(p + j - 1));
+        sum = Ops::add(sum, Ops::load(up + j));
+        sum = Ops::add(sum, Ops::load(down + j));
+        Ops::store(p + j, Ops::blend(mask, old, Ops::div(sum, four)));
+    }
+    if (j < n) {
+        scalarStencilKernels<Real>().redBlackRow(p + j, up + j, down + j, div + j, n - j, firstColumn);
+    }
+}
+
+template <typename Ops, int Width>
+void simdDivergenceRow(typename Ops::Scalar* div, const typename Ops::Scalar* u, const typename Ops::Scalar* vUp,
+                       const typename Ops::Scalar* vDown, int columns) {
+    using Real = typename Ops::Scalar;
+    const int n = Width > 0 ? Width : columns;
+    const auto minusHalf = Ops::set1(Real(-0.5));
+    int j = 0;
+    for (; j + Ops::lanes <= n; j += Ops::lanes) {
+        auto du = Ops::sub(Ops::load(u + j + 1), Ops::load(u + j - 1));
+        auto dv = Ops::sub(Ops::load(vUp + j), Ops::load(vDown + j));
+        Ops::store(div + j, Ops::mul(minusHalf, Ops::add(du, dv)));
+    }
+    if (j < n) {
+        scalarStencilKernels<Real>().divergenceRow(div + j, u + j, vUp + j, vDown + j, n - j);
+    }
+}
+
+template <typename Ops, int Width>
+void simdGradientRow(typename Ops::Scalar* u, typename Ops::Scalar* v, const typename Ops::Scalar* pUp,
+                     const typename Ops::Scalar* p, const typename Ops::Scalar* pDown, int columns) {
+    using Real = typename Ops::Scalar;
+    const int n = Width > 0 ? Width : columns;
+    const auto two = Ops::set1(Real(2));
+    int j = 0;
+    for (; j + Ops::lanes <= n; j += Ops::lanes) {
+        auto xGradient = Ops::div(Ops::sub(Ops::load(p + j + 1), Ops::load(p + j - 1)), two);
+        auto yGradient = Ops::div(Ops::sub(Ops::load(pUp + j), Ops::load(pDown + j)), two);
+        Ops::store(u + j, Ops::sub(Ops::load(u + j), xGradient));
+        Ops::store(v + j, Ops::sub(Ops::load(v + j), yGradient));
+    }
+    if (j < n) {
+        scalarStencilKernels<Real>().gradientRow(u + j, v + j, pUp + j, p + j, pDown + j, n - j);
+    }
+}
+
+template <typename Ops>
+void simdBlendRow(typename Ops::Scalar* out, const typename Ops::Scalar* from, const typename Ops::Scalar* to, int n,
+                  typename Ops::Scalar fromWeight, typename Ops::Scalar toWeight, typename Ops::Scalar denominator) {
+    using Real = typename Ops::Scalar;
+    const auto a = Ops::set1(fromWeight);
+    const auto b = Ops::set1(toWeight);
+    const auto d = Ops::set1(denominator);
+    int j = 0;
+    for (; j + Ops::lanes <= n; j += Ops::lanes) {
+        auto sum = Ops::add(Ops::mul(Ops::load(from + j), a), Ops::mul(Ops::load(to + j), b));
+        Ops::store(out + j, Ops::div(sum, d));
+    }
+    if (j < n) {
+        scalarStencilKernels<Real>().blendRow(out + j, from + j, to + j, n - j, fromWeight, toWeight, denominator);
+    }
+}
+
+template <typename Ops, int Width>
+constexpr StencilKernels<typename Ops::Scalar> simdKernelSet(const char* name) {
+    return { name, Width, simdJacobiRow<Ops, Width>, simdRedBlackRow<Ops, Width>,
+             simdDivergenceRow<Ops, Width>, simdGradientRow<Ops, Width>, simdBlendRow<Ops> };
+}
+
+#endif // STENCIL_KERNELS_SIMD_HPP
@@ -0,0 +1,80 @@
+#include "stencil_kernels.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#include "stencil_kernels_simd.hpp"
+
+namespace {
+
+// Two doubles or four floats per register
+
+template <typename Real>
+struct Ops;
+
+template <>
+struct Ops<double> {
+    using Scalar = double;
+    using Vector = __m128d;
+    using Mask = __m128d;
+    static constexpr int lanes = 2;
+    static Vector set1(double x) { return _mm_set1_pd(x); }
+    static Vector load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, Vector x) { _mm_storeu_pd(p, x); }
+    static Vector add(Vector a, Vector b) { return _mm_add_pd(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm_sub_pd(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm_mul_pd(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm_div_pd(a, b); }
+    static Mask colourMask(int firstColumn) {
+        return _mm_castsi128_pd(_mm_set_epi64x(firstColumn == 1 ? -1 : 0, firstColumn == 0 ? -1 : 0));
+    }
+    static Vector blend(Mask mask, Vector old, Vector updated) {
+        return _mm_or_pd(_mm_and_pd(mask, updated), _mm_andnot_pd(mask, old));
+    }
+};
+
+template <>
+struct Ops<float> {
+    using Scalar = float;
+    using Vector = __m128;
+    using Mask = __m128;
+    static constexpr int lanes = 4;
+    static Vector set1(float x) { return _mm_set1_ps(x); }
+    static Vector load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Vector x) { _mm_storeu_ps(p, x); }
+    static Vector add(Vector a, Vector b) { return _mm_add_ps(a, b); }
+    static Vector sub(Vector a, Vector b) { return _mm_sub_ps(a, b); }
+    static Vector mul(Vector a, Vector b) { return _mm_mul_ps(a, b); }
+    static Vector div(Vector a, Vector b) { return _mm_div_ps(a, b); }
+    static Mask colourMask(int firstColumn) {
+        int odd = firstColumn == 1 ? -1 : 0;
+        int even = firstColumn == 0 ? -1 : 0;
+        return _mm_castsi128_ps(_mm_set_epi32(odd, even, odd, even));
+    }
+    static Vector blend(Mask mask, Vector old, Vector updated) {
+        return _mm_or_ps(_mm_and_ps(mask, updated), _mm_andnot_ps(mask, old));
+    }
+};
+
+template <typename Real, int Width>
+struct Sse2Kernels {
+    static constexpr StencilKernels<Real> set = simdKernelSet<Ops<Real>, Width>("SSE2");
+};
+
+}
+
+template <typename Real>
+const StencilKernels<Real>* sse2StencilKernels(int width) {
+    return &kernelsForWidth<Real, Sse2Kernels>(width);
+}
+
+#else
+
+template <typename Real>
+const StencilKernels<Real>* sse2StencilKernels(int) {
+    return nullptr;
+}
+
+#endif
+
+template const StencilKernels<float>* sse2StencilKernels<float>(int);
+template const StencilKernels<double>* sse2StencilKernels<double>(int);
@@ -0,0 +1,150 @@
+#include "field2d.hpp"
+#include "stencil_kernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// Runs every kernel of every SIMD set this build and CPU support against the scalar reference
+// and exits non-zero on a mismatch. Rows have odd and power-of-two widths, with random
+// values in the halo, and the outputs are compared halo and all, so writes past either end
+// of a row show up as well as wrong values. Values may differ by a few units in the last place.
+// Usage: StencilKernelsTest
+
+namespace {
+
+const int WIDTHS[] = { 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 64, 65, 100, 127, 128, 129,
+                       255, 256, 257, 512, 1024, 2048 };
+
+template <typename Real>
+const StencilKernels<Real>* kernelsAt(SimdLevel level, int width) {
+    switch (level) {
+        case SimdLevel::SSE2: return sse2StencilKernels<Real>(width);
+        case SimdLevel::AVX2: return avx2StencilKernels<Real>(width);
+        case SimdLevel::AVX512: return avx512StencilKernels<Real>(width);
+        case SimdLevel::Scalar:
+        default: return &scalarStencilKernels<Real>(width);
+    }
+}
+
+// Three rows with a one-cell halo, every cell and ghost random
+template <typename Real>
+Field2D<Real> randomRows(int cols, std::mt19937& random) {
+    std::uniform_real_distribution<double> value(-1.0, 1.0);
+    Field2D<Real> field(3, cols, Real(0), 1);
+    for (int i = -1; i <= 3; i++) {
+        for (int j = -1; j <= cols; j++) {
+            field(i, j) = Real(value(random));
+        }
+    }
+    return field;
+}
+
+class Checker {
+public:
+    int failures = 0;
+    int checks = 0;
+    double worst = 0;   // largest difference seen, in units of epsilon relative to the reference
+
+    // Compares every cell of both fields, halo included
+    template <typename Real>
+    void compare(const Field2D<Real>& expected, const Field2D<Real>& actual, const std::string& what) {
+        const double epsilon = std::numeric_limits<Real>::epsilon();
+        checks++;
+        for (int i = -1; i <= expected.rows(); i++) {
+            for (int j = -1; j <= expected.cols(); j++) {
+                double e = expected(i, j);
+                double a = actual(i, j);
+                double error = std::abs(a - e) / (epsilon * std::max(1.0, std::abs(e)));
+                worst = std::max(worst, error);
+                if (!(error <= 4)) {
+                    std::cerr << "Mismatch in " << what << " at (" << i << ", " << j << "): expected " << e
+                              << ", got " << a << std::endl;
+                    failures++;
+                    return;
+                }
+            }
+        }
+    }
+};
+
+template <typename Real>
+void checkSet(const StencilKernels<Real>& reference, const StencilKernels<Real>& kernels, int n,
+              std::mt19937& random, Checker& checker) {
+    std::string where = std::string(kernels.name) + " " + precisionName(precisionOf<Real>()) + " width " + std::to_string(n);
+    Field2D<Real> a = randomRows<Real>(n, random);
+    Field2D<Real> b = randomRows<Real>(n, random);
+    Field2D<Real> c = randomRows<Real>(n, random);
+    Field2D<Real> out = randomRows<Real>(n, random);
+    const Real alpha = Real(0.37);
+    const Real denominator = Real(1 + 4 * 0.37);
+
+    Field2D<Real> expected = out;
+    Field2D<Real> actual = out;
+    reference.jacobiRow(expected.row(1), b.row(1), a.row(0), a.row(1), a.row(2), n, alpha, denominator);
+    kernels.jacobiRow(actual.row(1), b.row(1), a.row(0), a.row(1), a.row(2), n, alpha, denominator);
+    checker.compare(expected, actual, "jacobiRow, " + where);
+
+    for (int firstColumn = 0; firstColumn < 2; firstColumn++) {
+        expected = a;
+        actual = a;
+        reference.redBlackRow(expected.row(1), expected.row(0), expected.row(2), b.row(1), n, firstColumn);
+        kernels.redBlackRow(actual.row(1), actual.row(0), actual.row(2), b.row(1), n, firstColumn);
+        checker.compare(expected, actual, "redBlackRow from column " + std::to_string(firstColumn) + ", " + where);
+    }
+
+    expected = out;
+    actual = out;
+    reference.divergenceRow(expected.row(1), a.row(1), c.row(0), c.row(2), n);
+    kernels.divergenceRow(actual.row(1), a.row(1), c.row(0), c.row(2), n);
+    checker.compare(expected, actual, "divergenceRow, " + where);
+
+    expected = out;
+    actual = out;
+    Field2D<Real> expectedV = c;
+    Field2D<Real> actualV = c;
+    reference.gradientRow(expected.row(1), expectedV.row(1), a.row(0), a.row(1), a.row(2), n);
+    kernels.gradientRow(actual.row(1), actualV.row(1), a.row(0), a.row(1), a.row(2), n);
+    checker.compare(expected, actual, "gradientRow u, " + where);
+    checker.compare(expectedV, actualV, "gradientRow v, " + where);
+
+    expected = out;
+    actual = out;
+    reference.blendRow(expected.row(1), a.row(1), c.row(1), n, Real(3), Real(1), Real(4));
+    kernels.blendRow(actual.row(1), a.row(1), c.row(1), n, Real(3), Real(1), Real(4));
+    checker.compare(expected, actual, "blendRow, " + where);
+}
+
+template <typename Real>
+void checkAll(Checker& checker) {
+    std::mt19937 random(12345);
+    const StencilKernels<Real>& reference = scalarStencilKernels<Real>();
+    for (int l = 0; l <= static_cast<int>(detectSimdLevel()); l++) {
+        SimdLevel level = static_cast<SimdLevel>(l);
+        if (kernelsAt<Real>(level, 0) == nullptr) {
+            std::cout << simdLevelName(level) << " " << precisionName(precisionOf<Real>()) << ": not in this build" << std::endl;
+            continue;
+        }
+        int before = checker.failures;
+        for (int n : WIDTHS) {
+            checkSet(reference, *kernelsAt<Real>(level, n), n, random, checker);
+        }
+        std::cout << simdLevelName(level) << " " << precisionName(precisionOf<Real>()) << ": "
+                  << (checker.failures == before ? "ok" : "FAILED") << std::endl;
+    }
+}
+
+}
+
+int main() {
+    std::cout << "CPU supports up to " << simdLevelName(detectSimdLevel()) << std::endl;
+    Checker checker;
+    checkAll<float>(checker);
+    checkAll<double>(checker);
+    std::cout << checker.checks << " comparisons, " << checker.failures << " mismatches, largest difference "
+              << checker.worst << " epsilon" << std::endl;
+    return checker.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+    : bandCount(std::max(1, threadCount)), generation(0), pending(0), stopping(false),
+      invoke(nullptr), context(nullptr), itemCount(0) {
+    for (int band = 1; band < bandCount; band++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, band);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(int count, Invoke function, void* functionContext) {
+    if (bandCount == 1 || count < 2) {
+        function(functionContext, 0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        invoke = function;
+        context = functionContext;
+        itemCount = count;
+        pending = bandCount - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    runBand(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+}
+
+void ThreadPool::runBand(int band) {
+    int begin = static_cast<int>(static_cast<long long>(itemCount) * band / bandCount);
+    int end = static_cast<int>(static_cast<long long>(itemCount) * (band + 1) / bandCount);
+    if (begin < end) {
+        invoke(context, begin, end);
+    }
+}
+
+void ThreadPool::workerLoop(int band) {
+    std::uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+
+        runBand(band);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0) {
+            done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Persistent worker pool that splits an index range into one contiguous band per thread.
+// The calling thread works on the first band, and parallelFor() returns only after every
+// band is finished, so each call doubles as a barrier between sweeps.
+class ThreadPool {
+public:
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs body(begin, end) over [0, count) split into size() bands. Nothing is allocated per call.
+    template <typename Body>
+    void parallelFor(int count, Body&& body) {
+        using BodyType = std::remove_reference_t<Body>;
+        run(count, [](void* context, int begin, int end) {
+            (*static_cast<BodyType*>(context))(begin, end);
+        }, const_cast<void*>(static_cast<const void*>(&body)));
+    }
+
+    int size() const { return bandCount; }
+
+private:
+    using Invoke = void (*)(void*, int, int);
+
+    int bandCount;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::uint64_t generation;
+    int pending;
+    bool stopping;
+
+    // current job
+    Invoke invoke;
+    void* context;
+    int itemCount;
+
+    void run(int count, Invoke function, void* functionContext);
+    void runBand(int band);
+    void workerLoop(int band);
+};
+
+// Runs body(begin, end) over [0, count) on the pool, or in one call on this thread without one
+template <typename Body>
+void parallelRows(ThreadPool* pool, int count, Body&& body) {
+    if (pool) {
+        pool->parallelFor(count, body);
+    }
+    else {
+        body(0, count);
+    }
+}
+
+#endif // THREAD_POOL_HPP